@@ -0,0 +1,19 @@
+##	---------------------------------------------------
+##	--	Write a SPIR-V binary as a C++ header, run with cmake -P
+##	--	SPV_FILE: input binary, HEADER_FILE: output header, SYMBOL: array name
+##	---------------------------------------------------
+file(READ "${SPV_FILE}" SPV_HEX HEX)
+string(LENGTH "${SPV_HEX}" SPV_HEX_LENGTH)
+math(EXPR SPV_SIZE "${SPV_HEX_LENGTH} / 2")
+
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " SPV_BYTES "${SPV_HEX}")
+string(REPEAT "0x[0-9a-f][0-9a-f], " 16 SPV_LINE)
+string(REGEX REPLACE "(${SPV_LINE})" "\\1\n\t" SPV_BYTES "${SPV_BYTES}")
+
+file(WRITE "${HEADER_FILE}" 
+	"#pragma once\n\n"
+	"//	generated from ${SPV_FILE}, do not edit\n"
+	"#include <cstddef>\n\n"
+	"alignas(4) static const unsigned char ${SYMBOL}[] = {\n\t${SPV_BYTES}\n};\n"
+	"static constexpr size_t ${SYMBOL}_SIZE = ${SPV_SIZE};\n"
+)
@@ -6,7 +6,7 @@
 //	--	resource bindings:
 //	---------------------------------------------------
 
-//	framebuffer
+//	framebuffer (offscreen image when headless)
 layout (binding = 0) uniform writeonly image2D framebuffer;
 
 
@@ -30,12 +30,71 @@ layout (std430, binding = 4) buffer psiHalfBuffer {
 	vec2 psiHalf[]; 
 };
 
-//	time stepsize
+//	parametric potential primitive (mirrors PotentialPrimitive in src/schro.hpp)
+struct Primitive {
+	vec4 shape;		//	center.xy, extent.xy (cells)
+	vec4 motion;	//	center velocity.xy (cells/s), angular frequency (rad/s), phase (rad)
+	vec4 params;	//	amplitude (eV), type specific parameters
+	uvec4 info;		//	type, slit count
+};
+
+//	potential primitives evaluated every stage
+layout (std430, binding = 5) readonly buffer primitiveBuffer { 
+	Primitive primitives[]; 
+};
+
+//	reduction results, total in element 0 followed by one partial sum per workgroup
+layout (std430, binding = 6) buffer reductionBuffer { 
+	vec4 reduction[]; 
+};
+
+//	eigenstates found by imaginary time propagation, one grid per state
+layout (std430, binding = 7) buffer eigenstateBuffer { 
+	vec2 eigenstates[]; 
+};
+
+//	time stepsize and stage config
 layout (push_constant) uniform consts {
 	float dt; 
 	uint stage; 
+	float time;				//	simulation time at start of step (s)
+	uint primitiveCount;	//	number of active potential primitives
+	float packetX;			//	wave packet center x (cells)
+	float packetY;			//	wave packet center y (cells)
+	float packetK;			//	wave packet wavenumber (rad/cell)
+	float packetAngle;		//	wave packet direction (rad)
+	float packetSigma;		//	wave packet width (cells)
+	uint imaginary;			//	nonzero for imaginary time propagation
+	uint stateIdx;			//	eigenstate operated on by state stages
+	uint width;				//	grid width (cells)
+	uint height;			//	local grid height including halo rows (cells)
+	uint rowOffset;			//	global row of local row 0
+	uint globalHeight;		//	global grid height (cells)
+	uint rowBegin;			//	first local row covered by this dispatch
+	uint rowEnd;			//	one past the last local row covered by this dispatch
 };
 
+//	solver stages
+const uint STAGE_HALF_STEP = 0;
+const uint STAGE_FULL_STEP = 1;
+const uint STAGE_DRAW = 2;
+const uint STAGE_INIT_PACKET = 3;
+const uint STAGE_REDUCE = 4;
+const uint STAGE_REDUCE_FINAL = 5;
+const uint STAGE_NORMALIZE = 6;
+const uint STAGE_INIT_NOISE = 7;
+const uint STAGE_REDUCE_OVERLAP = 8;
+const uint STAGE_PROJECT = 9;
+const uint STAGE_STORE_STATE = 10;
+const uint STAGE_LOAD_STATE = 11;
+
+//	potential primitive types
+const uint PRIMITIVE_BOX = 0;
+const uint PRIMITIVE_SLITS = 1;
+const uint PRIMITIVE_HARMONIC = 2;
+const uint PRIMITIVE_GAUSSIAN = 3;
+const uint PRIMITIVE_PLANE_WAVE = 4;
+
 
 
 //	---------------------------------------------------
@@ -61,10 +120,46 @@ vec4 colorMap(vec2 psiValue, vec2 potentialValue) {
 	return ((psiValue.x >= 0) ? vec4(psiValue.x / 10, 0, 0, 1) : vec4(0, 0, -psiValue.x / 10, 1)) + well;
 }
 
-//	schrodinger step stage 1
-vec2 dPsiDt(uint idx, ivec2 shape) {
+//	value of a potential primitive at a cell and time
+float primitiveValue(Primitive p, vec2 pos, float t) {
+	vec2 d = pos - (p.shape.xy + p.motion.xy * t);
+	vec2 halfExtent = p.shape.zw / 2;
+	float amplitude = p.params.x * cos(p.motion.z * t + p.motion.w);
+
+	switch (p.info.x) {
+	case PRIMITIVE_BOX:
+		return (abs(d.x) <= halfExtent.x && abs(d.y) <= halfExtent.y) ? amplitude : 0;
+	case PRIMITIVE_SLITS:
+		//	wall of size extent with info.y openings of width params.y spaced params.z apart
+		if (abs(d.x) > halfExtent.x || abs(d.y) > halfExtent.y) return 0;
+		for (uint j = 0; j < p.info.y; j++) {
+			float offset = (float(j) - float(p.info.y - 1) / 2) * p.params.z;
+			if (abs(d.y - offset) <= p.params.y / 2) return 0;
+		}
+		return amplitude;
+	case PRIMITIVE_HARMONIC:
+		return amplitude * dot(d / p.shape.zw, d / p.shape.zw);
+	case PRIMITIVE_GAUSSIAN:
+		return amplitude * exp(-dot(d / p.shape.zw, d / p.shape.zw) / 2);
+	case PRIMITIVE_PLANE_WAVE:
+		//	driving field with wave vector params.yz (rad/cell)
+		return p.params.x * cos(dot(p.params.yz, pos) - p.motion.z * t + p.motion.w);
+	}
+	return 0;
+}
+
+//	static potential plus all primitives at a cell (global position) and time
+vec2 potentialAt(uint idx, ivec2 position, float t) {
+	vec2 v = potential[idx];
+	for (uint n = 0; n < primitiveCount; n++) {
+		v.x += primitiveValue(primitives[n], vec2(position), t);
+	}
+	return v;
+}
+
+//	hamiltonian applied to current wave function
+vec2 hPsi(uint idx, ivec2 shape, vec2 v) {
 	//	physical constants
-	vec2 i = vec2(0, 1);
 	float hBar = 6.582119569e-16;			//	eV * s
 	float electronMass = 5.685630111e-30;	//	eV / (nm/s)^2
 
@@ -74,13 +169,25 @@ vec2 dPsiDt(uint idx, ivec2 shape) {
 		+ psi[idx+shape.x-1] + 4 * psi[idx+shape.x] + psi[idx+shape.x+1]
 	) / 6;
 
-	return cMult(-i / hBar, (- hBar * hBar / (2 * electronMass)) * laplacian + cMult(psi[idx], potential[idx]));
+	return (- hBar * hBar / (2 * electronMass)) * laplacian + cMult(psi[idx], v);
+}
+
+//	time derivative from hamiltonian, -iH/hBar in real time or -H/hBar in imaginary time
+vec2 evolve(vec2 h) {
+	vec2 i = vec2(0, 1);
+	float hBar = 6.582119569e-16;			//	eV * s
+
+	return (imaginary != 0) ? -h / hBar : cMult(-i / hBar, h);
+}
+
+//	schrodinger step stage 1
+vec2 dPsiDt(uint idx, ivec2 shape, vec2 v) {
+	return evolve(hPsi(idx, shape, v));
 }
 
 //	schrodinger step stage 2
-vec2 dPsiDt2(uint idx, ivec2 shape) {
+vec2 dPsiDt2(uint idx, ivec2 shape, vec2 v) {
 	//	physical constants
-	vec2 i = vec2(0, 1);
 	float hBar = 6.582119569e-16;			//	eV * s
 	float electronMass = 5.685630111e-30;	//	eV / (nm/s)^2
 
@@ -90,7 +197,61 @@ vec2 dPsiDt2(uint idx, ivec2 shape) {
 		+ psiHalf[idx+shape.x-1] + 4 * psiHalf[idx+shape.x] + psiHalf[idx+shape.x+1]
 	) / 6;
 
-	return cMult(-i / hBar, (- hBar * hBar / (2 * electronMass)) * laplacian + cMult(psiHalf[idx], potential[idx]));
+	return evolve((- hBar * hBar / (2 * electronMass)) * laplacian + cMult(psiHalf[idx], v));
+}
+
+
+//	gaussian wave packet value at a global cell
+vec2 wavePacket(ivec2 position) {
+	vec2 d = vec2(position) - vec2(packetX, packetY);
+	float phase = packetK * (d.x * cos(packetAngle) + d.y * sin(packetAngle));
+	float envelope = exp(- dot(d, d) / (4 * packetSigma * packetSigma));
+	return envelope * vec2(cos(phase), sin(phase));
+}
+
+//	uniform pseudo random value in [0, 1) from a cell and seed
+float noise(uint idx, uint seed) {
+	uint h = idx * 747796405u + seed * 2891336453u + 1u;
+	h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+	h = (h >> 22u) ^ h;
+	return float(h) / 4294967296.0;
+}
+
+
+
+//	---------------------------------------------------
+//	--	reductions:
+//	---------------------------------------------------
+
+shared vec4 groupSums[32 * 32];
+
+//	sums value over the workgroup into its partial sum slot
+void reduceGroup(vec4 value) {
+	uint lid = gl_LocalInvocationIndex;
+	groupSums[lid] = value;
+	barrier();
+	for (uint s = (32 * 32) / 2; s > 0; s >>= 1) {
+		if (lid < s) groupSums[lid] += groupSums[lid + s];
+		barrier();
+	}
+	if (lid == 0) reduction[1 + gl_WorkGroupID.x + gl_NumWorkGroups.x * gl_WorkGroupID.y] = groupSums[0];
+}
+
+//	sums all partial sums into the total (dispatched as a single workgroup)
+void reduceFinal(ivec2 shape) {
+	uint lid = gl_LocalInvocationIndex;
+	uint count = uint((shape.x + 31) / 32) * uint((shape.y + 31) / 32);
+	vec4 sum = vec4(0);
+	for (uint n = lid; n < count; n += 32 * 32) {
+		sum += reduction[1 + n];
+	}
+	groupSums[lid] = sum;
+	barrier();
+	for (uint s = (32 * 32) / 2; s > 0; s >>= 1) {
+		if (lid < s) groupSums[lid] += groupSums[lid + s];
+		barrier();
+	}
+	if (lid == 0) reduction[0] = groupSums[0];
 }
 
 
@@ -102,30 +263,90 @@ vec2 dPsiDt2(uint idx, ivec2 shape) {
 layout (local_size_x = 32, local_size_y = 32) in;
 
 void main() {
-	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
-	ivec2 shape = imageSize(framebuffer);
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy) + ivec2(0, rowBegin);
+	ivec2 shape = ivec2(width, height);
+	bool inBounds = coord.x < shape.x && coord.y < int(rowEnd);
+
+	//	global position, slabs of a decomposed grid are offset by rowOffset
+	ivec2 position = coord + ivec2(0, rowOffset);
+	float cells = float(width) * float(globalHeight);
+
+	//	edges of the global grid are boundary, first and last local rows elsewhere are halos owned by neighbours
+	bool boundary = coord.x == 0 || coord.x == shape.x - 1 || position.y == 0 || position.y == int(globalHeight) - 1;
+	bool halo = !boundary && (coord.y == 0 || coord.y == shape.y - 1);
+	bool interior = inBounds && !boundary && !halo;
+
+	//	convert to flattened indexing
+	uint idx = coord.x + shape.x * coord.y;
+	uint stateOffset = stateIdx * uint(shape.x * shape.y);
+
+	//	reductions run before the bounds check so every thread reaches barrier()
+	//	norm of updated wave function, and <psi|H|psi>, <psi|psi> of current wave function
+	if (stage == STAGE_REDUCE) {
+		vec4 value = vec4(0);
+		if (interior) {
+			vec2 h = hPsi(idx, shape, potentialAt(idx, position, time));
+			value = vec4(dot(psi2[idx], psi2[idx]), dot(psi[idx], h), dot(psi[idx], psi[idx]), 0);
+		}
+		reduceGroup(value);
+		return;
+	}
+	//	<eigenstate|psi2>
+	if (stage == STAGE_REDUCE_OVERLAP) {
+		reduceGroup(interior ? vec4(cMult(conj(eigenstates[stateOffset + idx]), psi2[idx]), 0, 0) : vec4(0));
+		return;
+	}
+	if (stage == STAGE_REDUCE_FINAL) {
+		reduceFinal(shape);
+		return;
+	}
 
 	//	if thread out of bounds, return 
-	if (coord.x >= shape.x || coord.y >= shape.y) {
+	if (!inBounds) {
 		return;
 	}
-	
-	//	convert to flattened indexing
-	uint idx = coord.x + shape.x * coord.y;
 
 	//	boundary conditions
-	if (coord.x == 0 || coord.y == 0 || coord.x == shape.x - 1 || coord.y == shape.y - 1) {
+	if (boundary) {
 		psi2[idx] = vec2(0.0, 0.0);
 		psiHalf[idx] = vec2(0.0, 0.0);
 	}
+	//	halo rows are filled by exchange with neighbouring slabs
+	else if (halo && (stage == STAGE_HALF_STEP || stage == STAGE_FULL_STEP)) {
+		return;
+	}
 	//	half step solver
-	else if (stage == 0) {
-		psiHalf[idx] = psi[idx] + dPsiDt(idx, shape) * dt;
+	else if (stage == STAGE_HALF_STEP) {
+		psiHalf[idx] = psi[idx] + dPsiDt(idx, shape, potentialAt(idx, position, time)) * dt;
+	}
+	else if (stage == STAGE_FULL_STEP) {
+		//	imaginary time steps are not physical time, so eigenstates see the potential frozen at time
+		vec2 v0 = potentialAt(idx, position, time);
+		vec2 v1 = potentialAt(idx, position, (imaginary != 0) ? time : time + dt);
+		psi2[idx] = psi[idx] + (dPsiDt(idx, shape, v0) + dPsiDt2(idx, shape, v1)) * dt / 2;
+	}
+	else if (stage == STAGE_DRAW) {
+		imageStore(framebuffer, coord, colorMap(psi2[idx], potentialAt(idx, position, time + dt)));
+	}
+	//	wave packet initialization, normalized to unit mean density
+	else if (stage == STAGE_INIT_PACKET) {
+		psi2[idx] = wavePacket(position);
+	}
+	else if (stage == STAGE_NORMALIZE) {
+		psi2[idx] *= inversesqrt(reduction[0].x / cells);
+	}
+	//	imaginary time initial guess
+	else if (stage == STAGE_INIT_NOISE) {
+		psi2[idx] = vec2(noise(idx, stateIdx), 0);
+	}
+	//	gram-schmidt against an eigenstate normalized to unit mean density
+	else if (stage == STAGE_PROJECT) {
+		psi2[idx] -= cMult(reduction[0].xy / cells, eigenstates[stateOffset + idx]);
 	}
-	else if (stage == 1) {
-		psi2[idx] = psi[idx] + (dPsiDt(idx, shape) + dPsiDt2(idx, shape)) * dt / 2;
+	else if (stage == STAGE_STORE_STATE) {
+		eigenstates[stateOffset + idx] = psi2[idx];
 	}
-	else if (stage == 2) {
-		imageStore(framebuffer, coord, colorMap(psi2[idx], potential[idx]));
+	else if (stage == STAGE_LOAD_STATE) {
+		psi2[idx] = eigenstates[stateOffset + idx];
 	}
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+//	std lib
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+//	header
+#include "domain.hpp"
+
+
+
+
+
+
+
+//	---------------------------------------------------
+//	--	slab barrier:
+//	---------------------------------------------------
+#pragma region barrier;
+
+
+
+SlabBarrier::SlabBarrier(uint32_t count) : count_(count) {}
+
+
+
+void SlabBarrier::wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (aborted_) throw std::runtime_error("Slab barrier aborted");
+
+	uint64_t generation = generation_;
+	if (++waiting_ == count_) {
+		waiting_ = 0;
+		generation_++;
+		cv_.notify_all();
+		return;
+	}
+
+	cv_.wait(lock, [&] { return generation_ != generation || aborted_; });
+	if (generation_ == generation) throw std::runtime_error("Slab barrier aborted");
+}
+
+
+
+void SlabBarrier::abort() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	aborted_ = true;
+	cv_.notify_all();
+}
+
+
+
+
+//	---------------------------------------------------
+//	--	domain:
+//	---------------------------------------------------
+#pragma region domain;
+
+
+
+Domain::Domain(uint32_t width, uint32_t height, uint32_t slabCount)
+: width_(width), height_(height) {
+	//	rows between the global boundary rows are shared out, extra rows going to the first slabs
+	if (slabCount == 0 || height_ < 2 + 2 * slabCount) throw std::runtime_error("Grid is too small for the number of slabs");
+
+	uint32_t interiorRows = height_ - 2;
+	uint32_t firstRow = 1;
+	for (uint32_t rank = 0; rank < slabCount; rank++) {
+		uint32_t ownedRows = interiorRows / slabCount + (rank < interiorRows % slabCount ? 1 : 0);
+
+		Slab slab{};
+		slab.width = width_;
+		slab.height = ownedRows + 2;
+		slab.rowOffset = firstRow - 1;
+		slab.globalHeight = height_;
+		slab.deviceIndex = rank;
+		slabs_.emplace_back(slab);
+
+		firstRow += ownedRows;
+	}
+
+	edges_.resize(2 * 2 * (size_t)slabCount * width_);
+	normSums_.resize(slabCount);
+	energySums_.resize(slabCount);
+}
+
+
+
+std::complex<float>* Domain::edgeRow(uint32_t parity, uint32_t rank, uint32_t edge) {
+	return edges_.data() + (((size_t)parity * slabs_.size() + rank) * 2 + edge) * width_;
+}
+
+
+
+void Domain::run(const std::vector<PotentialPrimitive>& primitives, const WavePacket& packet,
+		float dt, uint64_t steps, uint32_t interval, const Observer& observer) {
+	SlabBarrier barrier((uint32_t)slabs_.size());
+
+	//	first failure is kept, failures it causes in other slabs through the aborted barrier are dropped
+	std::mutex errorMutex{};
+	std::exception_ptr error{};
+
+	std::vector<std::thread> threads{};
+	for (uint32_t rank = 0; rank < (uint32_t)slabs_.size(); rank++) {
+		threads.emplace_back([&, rank] {
+			try {
+				runSlab(rank, barrier, primitives, packet, dt, steps, interval, observer);
+			}
+			catch (...) {
+				{
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error) error = std::current_exception();
+				}
+				barrier.abort();
+			}
+		});
+	}
+	for (auto& thread : threads) thread.join();
+
+	if (error) std::rethrow_exception(error);
+}
+
+
+
+void Domain::runSlab(uint32_t rank, SlabBarrier& barrier, const std::vector<PotentialPrimitive>& primitives,
+		const WavePacket& packet, float dt, uint64_t steps, uint32_t interval, const Observer& observer) {
+	Schro2D schro(slabs_[rank]);
+	schro.setPotentials(primitives);
+	schro.setWavePacket(packet);
+
+	//	normalize against the whole grid
+	normSums_[rank] = schro.normSum();
+	barrier.wait();
+	double normSum = 0;
+	for (double sum : normSums_) normSum += sum;
+	schro.normalize(normSum);
+
+	//	edge rows are double buffered, so a slab publishing the next stage cannot overwrite rows a neighbour is still reading
+	const uint32_t lastRank = (uint32_t)slabs_.size() - 1;
+	uint32_t parity = 0;
+	HaloExchange exchange = [&](const std::complex<float>* firstRow, const std::complex<float>* lastRow,
+			std::complex<float>* topHalo, std::complex<float>* bottomHalo) {
+		std::copy(firstRow, firstRow + width_, edgeRow(parity, rank, 0));
+		std::copy(lastRow, lastRow + width_, edgeRow(parity, rank, 1));
+		barrier.wait();
+
+		if (rank > 0) {
+			const std::complex<float>* neighbourRow = edgeRow(parity, rank - 1, 1);
+			std::copy(neighbourRow, neighbourRow + width_, topHalo);
+		}
+		if (rank < lastRank) {
+			const std::complex<float>* neighbourRow = edgeRow(parity, rank + 1, 0);
+			std::copy(neighbourRow, neighbourRow + width_, bottomHalo);
+		}
+		parity ^= 1;
+	};
+
+	for (uint64_t step = 1; step <= steps; step++) {
+		schro.stepSlab(dt, exchange);
+
+		if (observer && interval != 0 && step % interval == 0) {
+			std::tie(normSums_[rank], energySums_[rank]) = schro.observableSums();
+			barrier.wait();
+			if (rank == 0) {
+				double normSum = 0, energySum = 0;
+				for (uint32_t i = 0; i < (uint32_t)slabs_.size(); i++) {
+					normSum += normSums_[i];
+					energySum += energySums_[i];
+				}
+
+				Observables observables{};
+				observables.step = step;
+				observables.time = (double)step * dt;
+				observables.norm = normSum / ((double)width_ * height_);
+				observables.energy = (normSum > 0) ? energySum / normSum : 0;
+				observer(observables, StateView{ width_, height_, nullptr });
+			}
+		}
+	}
+}
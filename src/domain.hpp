@@ -0,0 +1,62 @@
+#pragma once
+
+//	std lib
+#include <complex>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+//	headers
+#include "schro.hpp"
+
+
+
+
+
+
+
+//	blocks threads until all participants arrive, can be aborted to release waiters on error
+class SlabBarrier {
+public:
+	explicit SlabBarrier(uint32_t count);
+	//	waits for all participants, throws if the barrier was aborted
+	void wait();
+	//	releases all current and future waiters with an exception
+	void abort();
+
+private:
+	std::mutex mutex_{};
+	std::condition_variable cv_{};
+	const uint32_t count_;
+	uint32_t waiting_ = 0;
+	uint64_t generation_ = 0;
+	bool aborted_ = false;
+};
+
+
+
+//	grid split into horizontal slabs, each stepped by a headless solver on its own thread and device.
+//	one row halos are exchanged through host memory after each stage
+class Domain {
+public:
+	//	splits a width x height grid (cells) into slabCount slabs
+	Domain(uint32_t width, uint32_t height, uint32_t slabCount);
+	//	runs for steps, calling observer with global observables every interval steps (0 disables) on the first slab's thread.
+	//	slabs wait on the observer, and its state view holds no snapshot
+	void run(const std::vector<PotentialPrimitive>& primitives, const WavePacket& packet,
+		float dt, uint64_t steps, uint32_t interval, const Observer& observer);
+
+private:
+	//	steps one slab, called on its own thread
+	void runSlab(uint32_t rank, SlabBarrier& barrier, const std::vector<PotentialPrimitive>& primitives, 
+		const WavePacket& packet, float dt, uint64_t steps, uint32_t interval, const Observer& observer);
+	//	published edge row of a slab, 0 for first owned row and 1 for last, double buffered by parity
+	std::complex<float>* edgeRow(uint32_t parity, uint32_t rank, uint32_t edge);
+
+	const uint32_t width_;								//	grid width (cells)
+	const uint32_t height_;								//	grid height (cells)
+	std::vector<Slab> slabs_{};							//	slab layout
+	std::vector<std::complex<float>> edges_{};			//	published edge rows
+	std::vector<double> normSums_{};					//	per slab sum of |psi|^2
+	std::vector<double> energySums_{};					//	per slab sum of Re<psi|H|psi>
+};
@@ -1,94 +1,134 @@
 //	std lib
 #include <iostream>
-#include <complex>
-#include <vector>
-#include <string>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 //	headers
 #include "schro.hpp"
+#include "scene.hpp"
+#include "domain.hpp"
+
 
 
 
 
 
 
+//	steps a slab scene through the decomposed domain and through one whole grid solver, 
+//	returning false if norm or energy differ beyond tolerance at any output step
+static bool checkSlabs(const Scene& scene) {
+	constexpr double tolerance = 1e-4;	//	relative, covers float reduction order across slabs
+	const uint32_t width = (uint32_t)(scene.width * scene.scale);
+	const uint32_t height = (uint32_t)(scene.height * scene.scale);
+	const uint32_t interval = (scene.normInterval != 0) ? scene.normInterval : (uint32_t)std::min<uint64_t>(scene.steps, UINT32_MAX);
 
-std::complex<float> calc_psi(uint x, uint y, uint x0, uint y0, float E0, float alpha, float sigma) {
-	std::complex<float> i(0, 1);
-	float hBar = 6.582119569e-16;			//	eV * s
-	float electronMass = 5.685630111e-30;	//	eV / (nm/s)^2
+	std::vector<Observables> slabs{};
+	Domain domain(width, height, scene.slabs);
+	domain.run(scene.potentials, scene.packet, scene.dt, scene.steps, interval, 
+		[&](const Observables& observables, const StateView&) { slabs.emplace_back(observables); });
 
-	float dx = float(x) - float(x0);
-	float dy = float(y) - float(y0);
+	std::vector<Observables> whole{};
+	{
+		Schro2D schro(Slab::whole(width, height));
+		schro.setPotentials(scene.potentials);
+		schro.setWavePacket(scene.packet);
+		schro.setTimeStep(scene.dt);
+		schro.addObserver([&](const Observables& observables, const StateView&) { whole.emplace_back(observables); }, interval, false);
+		schro.step(scene.steps);
+		schro.flushObservers();
+	}
 
-	std::complex<float> wave = std::exp((i * std::sqrt(2 * electronMass * E0) / hBar) * (dx * std::cos(alpha) + dy * std::sin(alpha)));
-	std::complex<float> envelope = std::exp(- (((dx*dx) + (dy*dy)) / ( 4 * sigma * sigma)));
+	if (slabs.size() != whole.size() || slabs.empty()) {
+		std::cout << "Schro2D: slab check recorded " << slabs.size() << " outputs against " << whole.size() << "\n";
+		return false;
+	}
 
-	return wave * envelope;
+	auto close = [&](double a, double b) {
+		return std::abs(a - b) <= tolerance * std::max({ std::abs(a), std::abs(b), 1e-12 });
+	};
+
+	bool passed = true;
+	std::cout << "step,\tnorm (slabs),\tnorm (whole),\tenergy (slabs),\tenergy (whole)\n";
+	for (size_t i = 0; i < slabs.size(); i++) {
+		bool match = slabs[i].step == whole[i].step && close(slabs[i].norm, whole[i].norm) && close(slabs[i].energy, whole[i].energy);
+		std::cout << slabs[i].step << ",\t" << slabs[i].norm << ",\t" << whole[i].norm << ",\t" 
+			<< slabs[i].energy << ",\t" << whole[i].energy << (match ? "" : "\tmismatch") << "\n";
+		passed = passed && match;
+	}
+	std::cout << "Schro2D: slab check " << (passed ? "passed" : "failed") << "\n";
+	return passed;
 }
 
+
+
 int main(int argc, char* argv[]) {
-	Schro2D schro(500, 500, 2);
+	if (argc < 2 || (argc > 2 && std::string(argv[2]) != "--check-slabs")) {
+		std::cerr << "usage: Schro2D <scene file> [--check-slabs]\n";
+		return 1;
+	}
 
-	std::vector<std::vector<std::complex<float>>> psi(1000, std::vector<std::complex<float>>(1000, std::complex<float>(0, 0)));
-	std::vector<std::vector<std::complex<float>>> v(1000, std::vector<std::complex<float>>(1000, std::complex<float>(0, 0)));
+	try {
+		Scene scene = loadScene(argv[1]);
+		std::cout << "Schro2D: '" << scene.name << "'\n";
 
-	uint x0 = 200;		//	nm
-	uint y0 = 500;		//	nm
-	float E0 = 1e-2;	//	eV
-	float alpha = 0;	//	rad
-	float sigma = 50;	//	nm
+		//	decomposition check against a whole grid run of the same scene
+		if (argc > 2) {
+			if (scene.slabs < 2) throw std::runtime_error("--check-slabs needs a scene with slabs count of 2 or more");
+			return checkSlabs(scene) ? 0 : 1;
+		}
 
-	//	free particle
-	if (*argv[1] == '0') {
-		std::cout << "Schro2D: 'Wave Packet in Infinite Square Well'\n";
-	}
+		//	norm printout, without snapshots
+		Observer printNorm = [](const Observables& observables, const StateView&) {
+			std::cout << observables.step << ",\t" << observables.norm << "\n";
+		};
 
-	//	barrier
-	if (*argv[1] == '1') {
-		std::cout << "Schro2D: 'Wave Packet with Barrier'\n";
-		for (size_t i = 0; i < 1000; i++) {
-			for (size_t j = 0; j < 1000; j++) {
-				if (i >= 475 && i <= 525) v[j][i] = std::complex<float>(1e-2, 0.0);
-			}
+		//	decomposed runs are headless
+		if (scene.slabs > 1) {
+			Domain domain((uint32_t)(scene.width * scene.scale), (uint32_t)(scene.height * scene.scale), scene.slabs);
+			domain.run(scene.potentials, scene.packet, scene.dt, scene.steps, scene.normInterval, printNorm);
+			return 0;
 		}
-	}
 
-	//	slit
-	if (*argv[1] == '2') {
-		std::cout << "Schro2D: 'Wave Packet with Double Slit'\n";
-		for (size_t i = 0; i < 1000; i++) {
-			for (size_t j = 0; j < 1000; j++) {
-				if (i >= 475 && i <= 525) {
-					if (!((j >= 450 && j <= 475) || (j >= 525 && j <= 550))) {
-						v[j][i] = std::complex<float>(1e-2, 0.0);  
-					}
+		Schro2D schro(scene.width, scene.height, scene.scale);
+		schro.setPotentials(scene.potentials);
+
+		//	bound states, reused from the cache when grid, potentials and search settings match
+		if (scene.eigen.count > 0) {
+			if (scene.eigenCache.empty() || !schro.loadEigenstates(scene.eigenCache, scene.eigen)) {
+				std::vector<EigenResult> results = schro.findEigenstates(scene.eigen);
+				bool converged = true;
+				for (size_t i = 0; i < results.size(); i++) {
+					std::cout << "E" << i << ",\t" << results[i].energy << "\n";
+					if (!results[i].converged) std::cout << "Schro2D: eigenstate " << i << " did not converge\n";
+					converged = converged && results[i].converged;
 				}
+
+				//	unconverged states are not cached, so the next run searches again
+				if (!scene.eigenCache.empty() && converged) schro.saveEigenstates(scene.eigenCache);
+				else if (!scene.eigenCache.empty()) std::cout << "Schro2D: eigenstates not cached\n";
+			}
+			else {
+				std::cout << "Schro2D: loaded eigenstates from '" << scene.eigenCache << "'\n";
 			}
 		}
-	}
 
-	//	create wave packet
-	float psiNorm = 0;
-	for (size_t i = 0; i < 1000; i++) {
-		for (size_t j = 0; j < 1000; j++) {
-			auto psiValue = calc_psi(i, j, x0, y0, E0, alpha, sigma);
-			psi[j][i] = (std::abs(psiValue) > 0) ? psiValue : 0;
-			psiNorm += std::norm(psi[j][i]) / (float)(1000 * 1000);
-		}
+		if (scene.initialState >= 0) schro.setEigenstate((uint32_t)scene.initialState);
+		else schro.setWavePacket(scene.packet);
+
+		//	norm printout runs on the observer thread
+		if (scene.normInterval != 0) schro.addObserver(printNorm, scene.normInterval, false);
+		schro.run(scene.dt, scene.steps);
+		schro.flushObservers();
 	}
-	
-	//	normalize wavepacket
-	psiNorm = std::sqrt(psiNorm);
-	for (size_t i = 0; i < 1000; i++) {
-		for (size_t j = 0; j < 1000; j++) {
-			psi[j][i] /= psiNorm;
-		}
+	catch (const std::exception& e) {
+		std::cerr << "Schro2D: " << e.what() << "\n";
+		return 1;
 	}
 
-	float dt = 1e-15;
-	schro.run(psi, v, dt);
-
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,230 @@
+//	std lib
+#include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <map>
+
+//	header
+#include "scene.hpp"
+
+
+
+
+
+
+
+//	key=value fields following a directive, removed as they are read so leftovers can be reported
+class Fields {
+public:
+	Fields(std::istringstream& tokens, const std::string& where) : where_(where) {
+		std::string token;
+		while (tokens >> token) {
+			size_t split = token.find('=');
+			if (split == std::string::npos || split == 0) throw std::runtime_error(where_ + ": expected key=value, got '" + token + "'");
+			values_[token.substr(0, split)] = token.substr(split + 1);
+		}
+	}
+
+	//	reads a text field, returning fallback if absent
+	std::string text(const std::string& key, const std::string& fallback) {
+		auto it = values_.find(key);
+		if (it == values_.end()) return fallback;
+
+		std::string value = it->second;
+		values_.erase(it);
+		return value;
+	}
+
+	//	reads a numeric field, returning fallback if absent
+	double number(const std::string& key, double fallback) {
+		auto it = values_.find(key);
+		if (it == values_.end()) return fallback;
+
+		size_t parsed = 0;
+		double value = 0;
+		try {
+			value = std::stod(it->second, &parsed);
+		}
+		catch (const std::exception&) {
+			parsed = 0;
+		}
+		if (parsed == 0 || parsed != it->second.size() || !std::isfinite(value)) {
+			throw std::runtime_error(where_ + ": '" + key + "' is not a number");
+		}
+
+		values_.erase(it);
+		return value;
+	}
+
+	//	reads a numeric field that must be greater than zero, returning fallback if absent
+	double positive(const std::string& key, double fallback) {
+		double value = number(key, fallback);
+		if (!(value > 0)) throw std::runtime_error(where_ + ": '" + key + "' must be positive");
+		return value;
+	}
+
+	//	reads an integer field in [min, max], returning fallback if absent
+	int64_t integer(const std::string& key, int64_t fallback, int64_t min = 0, int64_t max = UINT32_MAX) {
+		if (values_.find(key) == values_.end()) return fallback;
+
+		double value = number(key, 0);
+		if (value != std::floor(value) || value < (double)min || value > (double)max) {
+			throw std::runtime_error(where_ + ": '" + key + "' must be an integer from " + std::to_string(min) + " to " + std::to_string(max));
+		}
+		return (int64_t)value;
+	}
+
+	//	throws if any field was not read
+	void finish() const {
+		if (!values_.empty()) throw std::runtime_error(where_ + ": unknown field '" + values_.begin()->first + "'");
+	}
+
+private:
+	std::string where_;
+	std::map<std::string, std::string> values_;
+};
+
+
+
+//	largest integer a double holds exactly
+constexpr int64_t MAX_EXACT_INTEGER = 1ll << 53;
+
+
+
+static PotentialPrimitive parsePotential(const std::string& type, Fields& fields, const std::string& where) {
+	static const std::map<std::string, PotentialType> types{
+		{ "box", PotentialType::Box },
+		{ "slits", PotentialType::Slits },
+		{ "harmonic", PotentialType::Harmonic },
+		{ "gaussian", PotentialType::Gaussian },
+		{ "planewave", PotentialType::PlaneWave }
+	};
+
+	auto it = types.find(type);
+	if (it == types.end()) throw std::runtime_error(where + ": unknown potential type '" + type + "'");
+
+	PotentialPrimitive primitive{};
+	primitive.type = it->second;
+	primitive.x = (float)fields.number("x", 0);
+	primitive.y = (float)fields.number("y", 0);
+	primitive.width = (float)fields.number("width", 0);
+	primitive.height = (float)fields.number("height", 0);
+	primitive.vx = (float)fields.number("vx", 0);
+	primitive.vy = (float)fields.number("vy", 0);
+	primitive.omega = (float)fields.number("omega", 0);
+	primitive.phase = (float)fields.number("phase", 0);
+	primitive.amplitude = (float)fields.number("amplitude", 0);
+
+	if ((primitive.type == PotentialType::Harmonic || primitive.type == PotentialType::Gaussian) && 
+			!(primitive.width > 0 && primitive.height > 0)) {
+		throw std::runtime_error(where + ": " + type + " potential needs a positive width and height");
+	}
+	if (primitive.type == PotentialType::Slits) {
+		primitive.param0 = (float)fields.number("opening", 0);
+		primitive.param1 = (float)fields.number("separation", 0);
+		primitive.count = (uint32_t)fields.integer("count", 2, 1);
+	}
+	if (primitive.type == PotentialType::PlaneWave) {
+		primitive.param0 = (float)fields.number("kx", 0);
+		primitive.param1 = (float)fields.number("ky", 0);
+	}
+
+	return primitive;
+}
+
+
+
+Scene loadScene(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) throw std::runtime_error("Failed to read scene file '" + path + "'");
+
+	Scene scene{};
+	std::string line;
+	for (size_t lineNumber = 1; std::getline(file, line); lineNumber++) {
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream tokens(line);
+		std::string directive;
+		if (!(tokens >> directive)) continue;
+
+		std::string where = path + ":" + std::to_string(lineNumber);
+
+		//	name takes the rest of the line verbatim
+		if (directive == "name") {
+			std::getline(tokens >> std::ws, scene.name);
+			scene.name = scene.name.substr(0, scene.name.find_last_not_of(" \t\r") + 1);
+			continue;
+		}
+
+		//	potential type precedes its fields
+		std::string potentialType;
+		if (directive == "potential" && !(tokens >> potentialType)) {
+			throw std::runtime_error(where + ": potential is missing a type");
+		}
+
+		Fields fields(tokens, where);
+		if (directive == "grid") {
+			scene.width = (uint32_t)fields.integer("width", scene.width, 1);
+			scene.height = (uint32_t)fields.integer("height", scene.height, 1);
+			scene.scale = fields.positive("scale", scene.scale);
+			if (scene.width * scene.scale < 4 || scene.height * scene.scale < 4) {
+				throw std::runtime_error(where + ": grid must be at least 4 x 4 cells");
+			}
+			if (scene.width * scene.scale * scene.height * scene.scale > (double)UINT32_MAX) {
+				throw std::runtime_error(where + ": grid has too many cells");
+			}
+		}
+		else if (directive == "time") {
+			scene.dt = (float)fields.positive("dt", scene.dt);
+			scene.steps = (uint64_t)fields.integer("steps", (int64_t)scene.steps, 0, MAX_EXACT_INTEGER);
+		}
+		else if (directive == "packet") {
+			scene.packet.x = (float)fields.number("x", scene.packet.x);
+			scene.packet.y = (float)fields.number("y", scene.packet.y);
+			scene.packet.energy = (float)fields.number("energy", scene.packet.energy);
+			scene.packet.angle = (float)fields.number("angle", scene.packet.angle);
+			scene.packet.sigma = (float)fields.positive("sigma", scene.packet.sigma);
+			if (scene.packet.energy < 0) throw std::runtime_error(where + ": 'energy' must not be negative");
+		}
+		else if (directive == "potential") {
+			scene.potentials.emplace_back(parsePotential(potentialType, fields, where));
+		}
+		else if (directive == "eigen") {
+			scene.eigen.count = (uint32_t)fields.integer("count", scene.eigen.count);
+			scene.eigen.dt = (float)fields.positive("dt", scene.eigen.dt);
+			scene.eigen.tolerance = (float)fields.positive("tolerance", scene.eigen.tolerance);
+			scene.eigen.checkInterval = (uint32_t)fields.integer("check", scene.eigen.checkInterval, 1);
+			scene.eigen.maxSteps = (uint64_t)fields.integer("max", (int64_t)scene.eigen.maxSteps, 1, MAX_EXACT_INTEGER);
+			scene.eigenCache = fields.text("cache", scene.eigenCache);
+		}
+		else if (directive == "state") {
+			scene.initialState = fields.integer("index", scene.initialState);
+		}
+		else if (directive == "slabs") {
+			scene.slabs = (uint32_t)fields.integer("count", scene.slabs, 1);
+		}
+		else if (directive == "output") {
+			scene.normInterval = (uint32_t)fields.integer("norm", scene.normInterval);
+		}
+		else {
+			throw std::runtime_error(where + ": unknown directive '" + directive + "'");
+		}
+		fields.finish();
+	}
+
+	//	a packet centered far outside the grid underflows to zero everywhere
+	if (scene.packet.x < 0 || scene.packet.x > scene.width * scene.scale || 
+			scene.packet.y < 0 || scene.packet.y > scene.height * scene.scale) {
+		throw std::runtime_error(path + ": packet center lies outside the grid");
+	}
+	if (scene.potentials.size() > Schro2D::MAX_PRIMITIVES) throw std::runtime_error(path + ": too many potentials");
+	if (scene.initialState >= (int64_t)scene.eigen.count) throw std::runtime_error(path + ": state index exceeds eigen count");
+	if (scene.slabs > 1 && (scene.eigen.count > 0 || scene.steps == 0)) {
+		throw std::runtime_error(path + ": slabs require a fixed step count and no eigenstate search");
+	}
+
+	return scene;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+//	std lib
+#include <string>
+#include <vector>
+
+//	headers
+#include "schro.hpp"
+
+
+
+
+
+
+
+//	simulation description loaded from a scene file
+struct Scene {
+	std::string name = "Schro2D";						//	title printed at startup
+
+	//	grid
+	uint32_t width = 500;								//	window width (pixels)
+	uint32_t height = 500;								//	window height (pixels)
+	double scale = 2;									//	multiplier for sim resolution
+
+	//	time
+	float dt = 1e-15;									//	time stepsize (s)
+	uint64_t steps = 0;									//	number of steps, 0 runs until window closes
+
+	//	initial conditions and potentials
+	WavePacket packet{};								//	initial wave packet
+	std::vector<PotentialPrimitive> potentials{};		//	parametric potentials
+
+	//	eigenstates
+	EigenSearch eigen{};								//	imaginary time search, skipped if count is 0
+	std::string eigenCache{};							//	eigenstate cache file, empty disables caching
+	int64_t initialState = -1;							//	eigenstate used as initial wave function, -1 uses packet
+
+	//	decomposition
+	uint32_t slabs = 1;									//	horizontal slabs run headless on separate devices, 1 uses a window
+
+	//	outputs
+	uint32_t normInterval = 100;						//	steps between norm printouts, 0 disables
+};
+
+
+
+//	parses a scene file of directives followed by key=value fields, e.g.
+//
+//		name Wave Packet with Barrier
+//		grid width=500 height=500 scale=2
+//		time dt=1e-15 steps=0
+//		packet x=200 y=500 energy=1e-2 angle=0 sigma=50
+//		potential box x=500 y=500 width=51 height=1000 amplitude=1e-2
+//		eigen count=3 dt=1e-15 tolerance=1e-6 check=100 max=100000 cache=well.eig
+//		state index=0
+//		slabs count=4
+//		output norm=100
+//
+//	'#' starts a comment. throws std::runtime_error naming the file and line on malformed input
+Scene loadScene(const std::string& path);
@@ -3,6 +3,9 @@
 #include <fstream>
 #include <complex>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 //	glfw3
 #define GLFW_INCLUDE_VULKAN
@@ -20,6 +23,9 @@
 //	header
 #include "schro.hpp"
 
+//	solver SPIR-V embedded by the build, so the library does not depend on files at runtime
+#include "schro_spv.hpp"
+
 //	debug and compatability options
 #ifdef DEBUG
 	constexpr bool VALIDATION_ENABLED = true;	//	toggle for including "VK_LAYER_KHRONOS_validation" layer
@@ -33,6 +39,88 @@
 	constexpr bool PORTABILITY_ENABLED = false;	//	toggle for including "VK_KHR_portability_subset" extension and related flags
 #endif
 
+//	push constant block (mirrors shaders/schro.glsl)
+struct PushConstants {
+	float dt;					//	time stepsize (s)
+	uint32_t stage;				//	solver stage
+	float time;					//	simulation time at start of step (s)
+	uint32_t primitiveCount;	//	number of active potential primitives
+	float packetX;				//	wave packet center x (cells)
+	float packetY;				//	wave packet center y (cells)
+	float packetK;				//	wave packet wavenumber (rad/cell)
+	float packetAngle;			//	wave packet direction (rad)
+	float packetSigma;			//	wave packet width (cells)
+	uint32_t imaginary;			//	nonzero for imaginary time propagation
+	uint32_t stateIdx;			//	eigenstate operated on by state stages
+	uint32_t width;				//	grid width (cells)
+	uint32_t height;			//	local grid height including halo rows (cells)
+	uint32_t rowOffset;			//	global row of local row 0
+	uint32_t globalHeight;		//	global grid height (cells)
+	uint32_t rowBegin;			//	first local row covered by this dispatch
+	uint32_t rowEnd;			//	one past the last local row covered by this dispatch
+};
+
+//	solver stages (mirrors shaders/schro.glsl)
+enum Stage : uint32_t {
+	STAGE_HALF_STEP = 0,
+	STAGE_FULL_STEP = 1,
+	STAGE_DRAW = 2,
+	STAGE_INIT_PACKET = 3,
+	STAGE_REDUCE = 4,
+	STAGE_REDUCE_FINAL = 5,
+	STAGE_NORMALIZE = 6,
+	STAGE_INIT_NOISE = 7,
+	STAGE_REDUCE_OVERLAP = 8,
+	STAGE_PROJECT = 9,
+	STAGE_STORE_STATE = 10,
+	STAGE_LOAD_STATE = 11
+};
+
+//	steps recorded into one submission by step
+constexpr uint64_t MAX_STEP_BATCH = 256;
+
+//	eigenstate cache file header, followed by energies and state grids
+struct EigenCacheHeader {
+	char magic[8];				//	EIGEN_CACHE_MAGIC
+	uint32_t width;				//	grid width (cells)
+	uint32_t height;			//	grid height (cells)
+	uint32_t count;				//	number of states, all converged
+	uint32_t version;			//	EIGEN_CACHE_VERSION
+	uint64_t key;				//	potentialKey() of the solver that wrote it
+	uint64_t searchKey;			//	searchKey() of the search that found the states
+};
+constexpr char EIGEN_CACHE_MAGIC[8] = { 'S', 'C', 'H', 'R', 'O', '2', 'D', 'E' };
+constexpr uint32_t EIGEN_CACHE_VERSION = 1;
+
+//	64 bit FNV-1a hash, chained through seed
+static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) seed = (seed ^ bytes[i]) * 1099511628211ull;
+	return seed;
+}
+
+//	hash of the eigenstate search settings that affect the states found, count excluded
+static uint64_t searchKey(const EigenSearch& search) {
+	uint32_t checkInterval = std::max(search.checkInterval, 1u);
+	uint64_t key = hashBytes(&search.dt, sizeof(search.dt));
+	key = hashBytes(&search.tolerance, sizeof(search.tolerance), key);
+	key = hashBytes(&checkInterval, sizeof(checkInterval), key);
+	return hashBytes(&search.maxSteps, sizeof(search.maxSteps), key);
+}
+
+//	makes all prior writes visible to subsequent commands and host reads
+static void memoryBarrier(vk::CommandBuffer cmdBuffer) {
+	vk::MemoryBarrier2 memoryBarrier{
+		vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryWrite,
+		vk::PipelineStageFlagBits2::eAllCommands | vk::PipelineStageFlagBits2::eHost, 
+		vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite
+	};
+
+	vk::DependencyInfo dependencyInfo{ vk::DependencyFlags(), memoryBarrier, nullptr, nullptr };
+
+	cmdBuffer.pipelineBarrier2(dependencyInfo);
+}
+
 
 
 
@@ -47,7 +135,9 @@
 
 
 Schro2D::Schro2D(uint32_t width, uint32_t height, double scale)
-: viewportWidth_(width), viewportHeight_(height), simScale_(scale) {
+: viewportWidth_(width), viewportHeight_(height), simScale_(scale), 
+gridWidth_(static_cast<uint32_t>(width * scale)), gridHeight_(static_cast<uint32_t>(height * scale)), 
+rowOffset_(0), globalHeight_(gridHeight_), deviceIndex_(0), headless_(false) {
 	if (VALIDATION_ENABLED) {
 		std::cout << "Schro2D: 'VK_LAYER_KHRONOS_validation' enabled" << std::endl;
 	}
@@ -62,6 +152,26 @@ Schro2D::Schro2D(uint32_t width, uint32_t height, double scale)
 	createDevice();
 	createAllocator();
 	createSwapChain();
+	createImmediateCommands();
+	createComputePipeline();
+}
+
+
+
+Schro2D::Schro2D(const Slab& slab)
+: viewportWidth_(slab.width), viewportHeight_(slab.height), simScale_(1), 
+gridWidth_(slab.width), gridHeight_(slab.height), 
+rowOffset_(slab.rowOffset), globalHeight_(slab.globalHeight), deviceIndex_(slab.deviceIndex), headless_(true) {
+	if (gridHeight_ < 4 || rowOffset_ + gridHeight_ > globalHeight_) throw std::runtime_error("Invalid slab");
+
+	//	create engine components
+	createInstance();
+	setPhysicalDevice();
+	setQueueFamily();
+	createDevice();
+	createAllocator();
+	createOffscreenImage();
+	createImmediateCommands();
 	createComputePipeline();
 }
 
@@ -69,12 +179,25 @@ Schro2D::Schro2D(uint32_t width, uint32_t height, double scale)
 
 
 Schro2D::~Schro2D() {
+	//	observer thread drains queued events before exiting
+	if (observerThread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(observerMutex_);
+			observerStopping_ = true;
+		}
+		observerCv_.notify_all();
+		observerThread_.join();
+	}
+
 	device_.waitIdle();
 
 	for (size_t i = 0; i < psiBuffer_.size(); i++) {
 		if (psiBuffer_[i]) vmaDestroyBuffer(allocator_, psiBuffer_[i], psiAlloc_[i]);
 	}
 	if (vBuffer_) vmaDestroyBuffer(allocator_, vBuffer_, vAlloc_);
+	if (primitiveBuffer_) vmaDestroyBuffer(allocator_, primitiveBuffer_, primitiveAlloc_);
+	if (reductionBuffer_) vmaDestroyBuffer(allocator_, reductionBuffer_, reductionAlloc_);
+	if (eigenBuffer_) vmaDestroyBuffer(allocator_, eigenBuffer_, eigenAlloc_);
 
 	if (descriptorPool_) device_.destroyDescriptorPool(descriptorPool_);
 	if (computePipeline_) device_.destroyPipeline(computePipeline_);
@@ -90,14 +213,21 @@ Schro2D::~Schro2D() {
 		device_.destroySemaphore(frame.imageSem);
 		device_.destroyFence(frame.fence);
 	}
+	for (auto fence : slabFences_) device_.destroyFence(fence);
+	if (immFence_) device_.destroyFence(immFence_);
+	if (immCmdPool_) device_.destroyCommandPool(immCmdPool_);
+	if (offscreenView_) device_.destroyImageView(offscreenView_);
+	if (offscreenImage_) vmaDestroyImage(allocator_, offscreenImage_, offscreenAlloc_);
 	if (swapchain_) device_.destroySwapchainKHR(swapchain_);
 	if (allocator_) vmaDestroyAllocator(allocator_);
 	if (device_) device_.destroy(); 
 	if (surface_) vkDestroySurfaceKHR(instance_, surface_, nullptr);
 	if (instance_) instance_.destroy(); 
 	
-	glfwDestroyWindow(window_);
-	glfwTerminate();
+	if (window_) {
+		glfwDestroyWindow(window_);
+		glfwTerminate();
+	}
 }
 
 
@@ -133,10 +263,12 @@ void Schro2D::createInstance() {
 	std::vector<const char*> extensions{};
 	
 	//	glfw extensions and flags
-	uint32_t glfwExtensionsCount = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
-	for (uint32_t i = 0; i < glfwExtensionsCount; i++) extensions.emplace_back(glfwExtensions[i]);
-	extensions.emplace_back(vk::EXTSwapchainColorSpaceExtensionName);
+	if (!headless_) {
+		uint32_t glfwExtensionsCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
+		for (uint32_t i = 0; i < glfwExtensionsCount; i++) extensions.emplace_back(glfwExtensions[i]);
+		extensions.emplace_back(vk::EXTSwapchainColorSpaceExtensionName);
+	}
 	
 	//	portability extensions and flags
 	if (PORTABILITY_ENABLED) {
@@ -151,6 +283,7 @@ void Schro2D::createInstance() {
 	//	create components
 	vk::InstanceCreateInfo instanceCreateInfo{ flags, &appInfo, layers, extensions };
 	instance_ = vk::createInstance(instanceCreateInfo);
+	if (headless_) return;
 
 	VkResult result = glfwCreateWindowSurface(instance_, window_, nullptr, &surface_);
 	if (result != VK_SUCCESS) throw std::runtime_error(string_VkResult(result));
@@ -161,12 +294,10 @@ void Schro2D::createInstance() {
 void Schro2D::setPhysicalDevice() {
 	//  TODO?:  improve device selection logic. 
 	//          fine for single gpu systems, but could cause problems if integrated graphics is front
+	//			slabs are spread over devices by index, wrapping so several slabs can share one device
 	std::vector<vk::PhysicalDevice> physicalDevices = instance_.enumeratePhysicalDevices();
-	if (physicalDevices.front()) { 
-		physicalDevice_ = physicalDevices.front();
-		return;
-	}
-	throw std::runtime_error("No suitable physical device was found");
+	if (physicalDevices.empty()) throw std::runtime_error("No suitable physical device was found");
+	physicalDevice_ = physicalDevices[deviceIndex_ % physicalDevices.size()];
 }
 
 
@@ -174,7 +305,9 @@ void Schro2D::setPhysicalDevice() {
 void Schro2D::setQueueFamily() {
 	//  TODO?:  improve queue family selection logic
 	//          choosing the first supported family is probably not optimal
-	constexpr vk::QueueFlags requiredFlags = vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
+	const vk::QueueFlags requiredFlags = headless_ ? 
+		vk::QueueFlags(vk::QueueFlagBits::eCompute) : 
+		vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute;
 	std::vector<vk::QueueFamilyProperties> queueFamilyProperties = physicalDevice_.getQueueFamilyProperties();
 	for (queueFamily_ = 0; queueFamily_ < (uint32_t)queueFamilyProperties.size(); queueFamily_++) {
 		if ((queueFamilyProperties[queueFamily_].queueFlags & requiredFlags) == requiredFlags) return;
@@ -189,7 +322,7 @@ void Schro2D::createDevice() {
 	vk::DeviceQueueCreateInfo deviceQueueCreateInfo = { vk::DeviceQueueCreateFlags(), queueFamily_, 1, &queuePriority };
 
 	std::vector<const char*> deviceExtensions{};
-	deviceExtensions.emplace_back(vk::KHRSwapchainExtensionName);
+	if (!headless_) deviceExtensions.emplace_back(vk::KHRSwapchainExtensionName);
 
 	//	portability device extension
 	if (PORTABILITY_ENABLED) deviceExtensions.emplace_back("VK_KHR_portability_subset");
@@ -307,22 +440,74 @@ void Schro2D::createSwapChain() {
 
 
 
-void Schro2D::createComputePipeline() {
-	// read SPIR-V file to create shader module
-    std::ifstream shaderFile("bin/schro.spv", std::ios::binary | std::ios::ate);
-    if (!shaderFile.is_open()) {
-        throw std::runtime_error("Failed to read shader file");
-    }
-    size_t shaderSize = (size_t)shaderFile.tellg();
-	std::vector<char> shaderData(shaderSize);
-
-    shaderFile.seekg(0);
-    shaderFile.read(shaderData.data(), shaderSize);
-	shaderFile.close();
+void Schro2D::createOffscreenImage() {
+	vk::ImageCreateInfo imageCreateInfo{
+		vk::ImageCreateFlags(),
+		vk::ImageType::e2D,
+		vk::Format::eR8G8B8A8Unorm,
+		{ gridWidth_, gridHeight_, 1 },
+		1,
+		1,
+		vk::SampleCountFlagBits::e1,
+		vk::ImageTiling::eOptimal,
+		vk::ImageUsageFlagBits::eStorage | 
+		vk::ImageUsageFlagBits::eTransferSrc,
+		vk::SharingMode::eExclusive
+	};
+
+	VmaAllocationCreateInfo imageAllocInfo{};
+	imageAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
 
+	VkResult result = vmaCreateImage(
+		allocator_, imageCreateInfo, &imageAllocInfo, 
+		reinterpret_cast<VkImage*>(&offscreenImage_), &offscreenAlloc_, nullptr
+	);
+	if (result != VK_SUCCESS) throw std::runtime_error(string_VkResult(result));
+
+	vk::ImageViewCreateInfo imageViewCreateInfo{
+		vk::ImageViewCreateFlags(),
+		offscreenImage_,
+		vk::ImageViewType::e2D,
+		vk::Format::eR8G8B8A8Unorm,
+		{
+			vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity,
+			vk::ComponentSwizzle::eIdentity, vk::ComponentSwizzle::eIdentity
+		},
+		{ 
+			vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 
+		}
+	};
+
+	offscreenView_ = device_.createImageView(imageViewCreateInfo);
+}
+
+
+
+void Schro2D::createImmediateCommands() {
+	immCmdPool_ = device_.createCommandPool({vk::CommandPoolCreateFlagBits::eResetCommandBuffer, queueFamily_});
+
+	vk::CommandBufferAllocateInfo commandBufferAllocateInfo{ immCmdPool_, vk::CommandBufferLevel::ePrimary, 1 };
+
+	immCmdBuffer_ = device_.allocateCommandBuffers(commandBufferAllocateInfo).front();
+	immFence_ = device_.createFence(vk::FenceCreateInfo());
+
+	//	slab steps submit edge rows and interior rows separately
+	if (headless_) {
+		vk::CommandBufferAllocateInfo slabAllocateInfo{ immCmdPool_, vk::CommandBufferLevel::ePrimary, 2 };
+
+		slabCmdBuffers_ = device_.allocateCommandBuffers(slabAllocateInfo);
+		for (size_t i = 0; i < slabCmdBuffers_.size(); i++) slabFences_.emplace_back(device_.createFence(vk::FenceCreateInfo()));
+		haloRows_.resize(4 * (size_t)gridWidth_);
+	}
+}
+
+
+
+void Schro2D::createComputePipeline() {
+	// create shader module from embedded SPIR-V
     vk::ShaderModuleCreateInfo shaderModuleCreateInfo{
 		vk::ShaderModuleCreateFlags(),
-		(uint32_t)shaderSize, reinterpret_cast<const uint32_t*>(shaderData.data()),
+		SCHRO_SPV_SIZE, reinterpret_cast<const uint32_t*>(SCHRO_SPV),
 	};
 
     shaderModule_ = device_.createShaderModule(shaderModuleCreateInfo);
@@ -335,7 +520,7 @@ void Schro2D::createComputePipeline() {
 	psiAlloc_.resize(3);
 	vk::BufferCreateInfo storageBufferCreateInfo{
 		vk::BufferCreateFlags(), 
-		sizeof(float) * (uint32_t)(2 * viewportWidth_ * viewportHeight_ * simScale_ * simScale_), 
+		sizeof(float) * 2 * gridWidth_ * gridHeight_, 
 		vk::BufferUsageFlagBits::eStorageBuffer | 
 		vk::BufferUsageFlagBits::eTransferDst, 
 		vk::SharingMode::eExclusive
@@ -353,13 +538,41 @@ void Schro2D::createComputePipeline() {
 		reinterpret_cast<VkBuffer*>(&vBuffer_), &vAlloc_, nullptr
 	);
 
+	vk::BufferCreateInfo primitiveBufferCreateInfo{
+		vk::BufferCreateFlags(), 
+		sizeof(PotentialPrimitive) * MAX_PRIMITIVES, 
+		vk::BufferUsageFlagBits::eStorageBuffer | 
+		vk::BufferUsageFlagBits::eTransferDst, 
+		vk::SharingMode::eExclusive
+	};
+	vmaCreateBuffer(
+		allocator_, primitiveBufferCreateInfo, &gpuAllocInfo, 
+		reinterpret_cast<VkBuffer*>(&primitiveBuffer_), &primitiveAlloc_, nullptr
+	);
+
+	//	total followed by one partial sum per workgroup
+	vk::BufferCreateInfo reductionBufferCreateInfo{
+		vk::BufferCreateFlags(), 
+		sizeof(float) * 4 * (1 + ((gridWidth_ + 31) / 32) * ((gridHeight_ + 31) / 32)), 
+		vk::BufferUsageFlagBits::eStorageBuffer | 
+		vk::BufferUsageFlagBits::eTransferDst, 
+		vk::SharingMode::eExclusive
+	};
+	vmaCreateBuffer(
+		allocator_, reductionBufferCreateInfo, &gpuAllocInfo, 
+		reinterpret_cast<VkBuffer*>(&reductionBuffer_), &reductionAlloc_, nullptr
+	);
+
 	// boring vulkan boilerplate
 	std::vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings{
 		{ 0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute },
 		{ 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
 		{ 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
 		{ 3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
-		{ 4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }
+		{ 4, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
+		{ 5, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
+		{ 6, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute },
+		{ 7, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute }
 	};
 
 	vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
@@ -368,7 +581,7 @@ void Schro2D::createComputePipeline() {
 
 	descriptorSetLayout_ = device_.createDescriptorSetLayout(descriptorSetLayoutCreateInfo);
 
-	vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(float) + sizeof(uint32_t) };
+	vk::PushConstantRange pushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants) };
 
 	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{
 		vk::PipelineLayoutCreateFlags(), descriptorSetLayout_, pushConstantRange
@@ -386,15 +599,19 @@ void Schro2D::createComputePipeline() {
 
 	computePipeline_ = device_.createComputePipeline(nullptr, computePipelineCreateInfo).value;
 
+	//	a ping-pong pair of sets per image drawn to, stages that do not draw use the first pair
+	const uint32_t imageCount = headless_ ? 1 : static_cast<uint32_t>(frameData_.size());
+	const uint32_t setCount = 2 * imageCount;
+
 	std::vector<vk::DescriptorPoolSize> descriptorPoolSizes{
-		{ vk::DescriptorType::eStorageImage, 2 }, { vk::DescriptorType::eStorageBuffer, 8 }
+		{ vk::DescriptorType::eStorageImage, setCount }, { vk::DescriptorType::eStorageBuffer, 7 * setCount }
 	};
 
-	vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{ vk::DescriptorPoolCreateFlags(), 2, descriptorPoolSizes };
+	vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo{ vk::DescriptorPoolCreateFlags(), setCount, descriptorPoolSizes };
 
 	descriptorPool_ = device_.createDescriptorPool(descriptorPoolCreateInfo);
 
-	std::vector<vk::DescriptorSetLayout> layouts(2, descriptorSetLayout_);
+	std::vector<vk::DescriptorSetLayout> layouts(setCount, descriptorSetLayout_);
 
 	vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo{ descriptorPool_, layouts };
 
@@ -402,22 +619,146 @@ void Schro2D::createComputePipeline() {
 
 	std::vector<vk::DescriptorBufferInfo> descriptorBufferInfos{
 		{ psiBuffer_[0], 0, vk::WholeSize }, { psiBuffer_[1], 0, vk::WholeSize }, 
-		{ vBuffer_, 0, vk::WholeSize }, { psiBuffer_[2], 0, vk::WholeSize }
+		{ vBuffer_, 0, vk::WholeSize }, { psiBuffer_[2], 0, vk::WholeSize }, 
+		{ primitiveBuffer_, 0, vk::WholeSize }, { reductionBuffer_, 0, vk::WholeSize }
 	};
 
-	for (size_t i = 0; i < 2; i++) {
-		vk::DescriptorImageInfo descriptorImageInfo{ nullptr, frameData_[i].view, vk::ImageLayout::eGeneral };
+	for (size_t i = 0; i < setCount; i++) {
+		size_t parity = i % 2;
+		vk::DescriptorImageInfo descriptorImageInfo{ nullptr, headless_ ? offscreenView_ : frameData_[i / 2].view, vk::ImageLayout::eGeneral };
 
 		std::vector<vk::WriteDescriptorSet> writeDescriptorSets{ 
 			{ descriptorSets_[i], 0, 0, 1, vk::DescriptorType::eStorageImage, &descriptorImageInfo, nullptr, nullptr },
-			{ descriptorSets_[i], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[i], nullptr },
-			{ descriptorSets_[i], 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[i ^ 1], nullptr },
+			{ descriptorSets_[i], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[parity], nullptr },
+			{ descriptorSets_[i], 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[parity ^ 1], nullptr },
 			{ descriptorSets_[i], 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[2], nullptr },
-			{ descriptorSets_[i], 4, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[3], nullptr }
+			{ descriptorSets_[i], 4, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[3], nullptr },
+			{ descriptorSets_[i], 5, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[4], nullptr },
+			{ descriptorSets_[i], 6, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfos[5], nullptr }
 		};
 
 		device_.updateDescriptorSets(writeDescriptorSets, nullptr);
 	}
+
+	//	eigenstate buffer must be bound before first dispatch
+	reserveEigenstates(1);
+
+	//	static potential defaults to zero, offscreen image stays in general layout
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.fillBuffer(vBuffer_, 0, vk::WholeSize, 0);
+
+		if (headless_) {
+			vk::ImageSubresourceRange imageSubresourceRange{
+				vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, vk::RemainingArrayLayers
+			};
+
+			vk::ImageMemoryBarrier2 imageBarrier{
+				vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryWrite,
+				vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead,
+				vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+				queueFamily_, queueFamily_, offscreenImage_, imageSubresourceRange
+			};
+
+			vk::DependencyInfo dependencyInfo{ vk::DependencyFlags(), nullptr, nullptr, imageBarrier };
+
+			cmdBuffer.pipelineBarrier2(dependencyInfo);
+		}
+	});
+}
+
+
+
+//	---------------------------------------------------
+//	--	command recording:
+//	---------------------------------------------------
+#pragma region command recording;
+
+
+
+void Schro2D::submitImmediate(const std::function<void(vk::CommandBuffer)>& record) {
+	immCmdBuffer_.reset();
+	immCmdBuffer_.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	record(immCmdBuffer_);
+	memoryBarrier(immCmdBuffer_);
+	immCmdBuffer_.end();
+
+	vk::CommandBufferSubmitInfo commandBufferSubmitInfo{ immCmdBuffer_, 0 };
+
+	vk::SubmitInfo2 submitInfo{ vk::SubmitFlagBits(), nullptr, commandBufferSubmitInfo, nullptr };
+
+	queue_.submit2(submitInfo, immFence_);
+
+	vk::Result waitResult = device_.waitForFences(immFence_, true, UINT64_MAX);
+	if (waitResult != vk::Result::eSuccess) throw std::runtime_error(vk::to_string(waitResult));
+	device_.resetFences(immFence_);
+}
+
+
+
+void Schro2D::recordStage(vk::CommandBuffer cmdBuffer, uint32_t stage, float dt, uint32_t stateIdx, 
+		uint32_t rowBegin, uint32_t rowEnd) {
+	rowEnd = std::min(rowEnd, gridHeight_);
+
+	constexpr double hBar = 6.582119569e-16;			//	eV * s
+	constexpr double electronMass = 5.685630111e-30;	//	eV / (nm/s)^2
+
+	PushConstants pushConstants{
+		dt, stage, static_cast<float>(time_), (uint32_t)primitives_.size(),
+		packet_.x, packet_.y, 
+		static_cast<float>(std::sqrt(2 * electronMass * packet_.energy) / hBar), 
+		packet_.angle, packet_.sigma, 
+		imaginaryTime_ ? 1u : 0u, stateIdx,
+		gridWidth_, gridHeight_, rowOffset_, globalHeight_, rowBegin, rowEnd
+	};
+	cmdBuffer.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &pushConstants);
+
+	//	final reduction runs as a single workgroup
+	if (stage == STAGE_REDUCE_FINAL) cmdBuffer.dispatch(1, 1, 1);
+	else cmdBuffer.dispatch((gridWidth_ + 31) / 32, (rowEnd - rowBegin + 31) / 32, 1);
+}
+
+
+
+void Schro2D::reserveEigenstates(uint32_t count) {
+	if (count <= eigenCapacity_) return;
+	device_.waitIdle();
+
+	if (eigenBuffer_) vmaDestroyBuffer(allocator_, eigenBuffer_, eigenAlloc_);
+
+	VmaAllocationCreateInfo gpuAllocInfo{};
+	gpuAllocInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	gpuAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT; 
+
+	vk::BufferCreateInfo eigenBufferCreateInfo{
+		vk::BufferCreateFlags(), 
+		sizeof(std::complex<float>) * gridWidth_ * gridHeight_ * count, 
+		vk::BufferUsageFlagBits::eStorageBuffer | 
+		vk::BufferUsageFlagBits::eTransferDst, 
+		vk::SharingMode::eExclusive
+	};
+	VkResult result = vmaCreateBuffer(
+		allocator_, eigenBufferCreateInfo, &gpuAllocInfo, 
+		reinterpret_cast<VkBuffer*>(&eigenBuffer_), &eigenAlloc_, nullptr
+	);
+	if (result != VK_SUCCESS) throw std::runtime_error(string_VkResult(result));
+	eigenCapacity_ = count;
+
+	vk::DescriptorBufferInfo descriptorBufferInfo{ eigenBuffer_, 0, vk::WholeSize };
+	for (const auto& descriptorSet : descriptorSets_) {
+		vk::WriteDescriptorSet writeDescriptorSet{ 
+			descriptorSet, 7, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &descriptorBufferInfo, nullptr 
+		};
+		device_.updateDescriptorSets(writeDescriptorSet, nullptr);
+	}
+}
+
+
+
+uint64_t Schro2D::potentialKey() const {
+	uint64_t key = hashBytes(&gridWidth_, sizeof(gridWidth_));
+	key = hashBytes(&gridHeight_, sizeof(gridHeight_), key);
+	key = hashBytes(primitives_.data(), sizeof(PotentialPrimitive) * primitives_.size(), key);
+	return hashBytes(&staticPotentialHash_, sizeof(staticPotentialHash_), key);
 }
 
 
@@ -460,14 +801,15 @@ void Schro2D::draw(uint8_t frameIdx, float pushConst) {
 
     frameData_[frameIdx].cmdBuffer.pipelineBarrier2(dependencyInfo);
 
-	//	do schrodinger equation
+	//	do schrodinger equation, the set pairs the acquired image with the current wave function buffer
 	frameData_[frameIdx].cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
-	frameData_[frameIdx].cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[imageIdx], nullptr);
+	frameData_[frameIdx].cmdBuffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[2 * imageIdx + current_], nullptr
+	);
 
-	for (uint32_t stage = 0; stage < 3; stage++) {
-		frameData_[frameIdx].cmdBuffer.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eCompute, 0, sizeof(float), &pushConst);
-		frameData_[frameIdx].cmdBuffer.pushConstants(pipelineLayout_, vk::ShaderStageFlagBits::eCompute, sizeof(float), sizeof(uint32_t), &stage);
-		frameData_[frameIdx].cmdBuffer.dispatch((simScale_ * viewportWidth_ + 31) / 32, (simScale_ * viewportHeight_ + 31) / 32, 1);
+	for (uint32_t stage : { STAGE_HALF_STEP, STAGE_FULL_STEP, STAGE_DRAW }) {
+		recordStage(frameData_[frameIdx].cmdBuffer, stage, pushConst);
+		memoryBarrier(frameData_[frameIdx].cmdBuffer);
 	}
 
     vk::ImageMemoryBarrier2 imageBarrier2{
@@ -509,39 +851,576 @@ void Schro2D::draw(uint8_t frameIdx, float pushConst) {
 
 
 
-void Schro2D::run(std::vector<std::vector<std::complex<float>>>& wavefn,
-		std::vector<std::vector<std::complex<float>>>& potential, float pushConst) {
-	//	prep and load gpu arrays
-	std::vector<std::complex<float>> psi{};
-	for (const auto& row : wavefn) for (const auto& coord : row) psi.emplace_back(coord);
-	vmaCopyMemoryToAllocation(allocator_, psi.data(), psiAlloc_[0], 0, sizeof(std::complex<float>) * psi.size());
-	vmaCopyMemoryToAllocation(allocator_, psi.data(), psiAlloc_[1], 0, sizeof(std::complex<float>) * psi.size());
+void Schro2D::setPotentials(const std::vector<PotentialPrimitive>& primitives) {
+	checkCallerThread();
+	if (primitives.size() > MAX_PRIMITIVES) throw std::runtime_error("Too many potential primitives");
+
+	//	harmonic and gaussian primitives are scaled by their extent
+	for (const auto& primitive : primitives) {
+		bool scaled = primitive.type == PotentialType::Harmonic || primitive.type == PotentialType::Gaussian;
+		if (scaled && !(primitive.width > 0 && primitive.height > 0)) {
+			throw std::runtime_error("Harmonic and gaussian primitives need a positive width and height");
+		}
+	}
+
+	//	primitive buffer may still be read by frames in flight
+	device_.waitIdle();
+	if (!primitives.empty()) {
+		vmaCopyMemoryToAllocation(allocator_, primitives.data(), primitiveAlloc_, 0, sizeof(PotentialPrimitive) * primitives.size());
+	}
+	primitives_ = primitives;
+}
+
 
-	std::vector<std::complex<float>> v{};
-	for (const auto& row : potential) for (const auto& coord : row) v.emplace_back(coord);
-	vmaCopyMemoryToAllocation(allocator_, v.data(), vAlloc_, 0, sizeof(std::complex<float>) * v.size());
+
+void Schro2D::setStaticPotential(const std::vector<std::complex<float>>& potential) {
+	checkCallerThread();
+	if (potential.size() != (size_t)gridWidth_ * gridHeight_) throw std::runtime_error("Static potential does not match grid size");
+
+	device_.waitIdle();
+	vmaCopyMemoryToAllocation(allocator_, potential.data(), vAlloc_, 0, sizeof(std::complex<float>) * potential.size());
+	staticPotentialHash_ = hashBytes(potential.data(), sizeof(std::complex<float>) * potential.size());
+}
+
+
+
+void Schro2D::setWavePacket(const WavePacket& packet) {
+	checkCallerThread();
+	device_.waitIdle();
+	packet_ = packet;
+	time_ = 0;
+
+	//	each descriptor set writes the other wave function buffer, so initialize through both
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+		for (uint32_t i = 0; i < 2; i++) {
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[i], nullptr);
+			recordStage(cmdBuffer, STAGE_INIT_PACKET, 0);
+			memoryBarrier(cmdBuffer);
+		}
+	});
+	current_ = 0;
+	stepCount_ = 0;
+
+	//	a slab only sees part of the norm, both buffers hold the same packet so one sum normalizes both
+	if (gridHeight_ == globalHeight_) normalize(normSum());
+}
+
+
+
+double Schro2D::normSum() {
+	checkCallerThread();
+	device_.waitIdle();
+
+	//	descriptor set current ^ 1 writes, and so reduces, wave function buffer current
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current_ ^ 1], nullptr);
+		for (uint32_t stage : { STAGE_REDUCE, STAGE_REDUCE_FINAL }) {
+			recordStage(cmdBuffer, stage, 0);
+			memoryBarrier(cmdBuffer);
+		}
+	});
+
+	float totals[4];
+	vmaCopyAllocationToMemory(allocator_, reductionAlloc_, 0, totals, sizeof(totals));
+	return totals[0];
+}
+
+
+
+std::pair<double, double> Schro2D::observableSums() {
+	checkCallerThread();
+	device_.waitIdle();
+
+	//	descriptor set current reads wave function buffer current as psi
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current_], nullptr);
+		for (uint32_t stage : { STAGE_REDUCE, STAGE_REDUCE_FINAL }) {
+			recordStage(cmdBuffer, stage, 0);
+			memoryBarrier(cmdBuffer);
+		}
+	});
+
+	float totals[4];
+	vmaCopyAllocationToMemory(allocator_, reductionAlloc_, 0, totals, sizeof(totals));
+	return { totals[2], totals[1] };
+}
+
+
+
+void Schro2D::normalize(double globalNormSum) {
+	checkCallerThread();
+	//	an envelope that underflows on every cell would normalize to inf and NaN
+	if (!(globalNormSum > 0) || !std::isfinite(globalNormSum)) {
+		throw std::runtime_error("Wave function has no norm, the packet may be centered outside the grid");
+	}
+	device_.waitIdle();
+
+	float totals[4] = { static_cast<float>(globalNormSum), 0, 0, 0 };
+	vmaCopyMemoryToAllocation(allocator_, totals, reductionAlloc_, 0, sizeof(totals));
+
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+		cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current_ ^ 1], nullptr);
+		recordStage(cmdBuffer, STAGE_NORMALIZE, 0);
+	});
+}
+
+
+
+void Schro2D::stepSlab(float dt, const HaloExchange& exchange) {
+	checkCallerThread();
+	const size_t rowSize = sizeof(std::complex<float>) * gridWidth_;
+	std::complex<float>* firstRow = haloRows_.data();
+	std::complex<float>* lastRow = firstRow + gridWidth_;
+	std::complex<float>* topHalo = lastRow + gridWidth_;
+	std::complex<float>* bottomHalo = topHalo + gridWidth_;
+
+	for (uint32_t stage : { STAGE_HALF_STEP, STAGE_FULL_STEP }) {
+		//	edge rows first, then interior rows, so the halo exchange overlaps the interior dispatch
+		for (size_t i = 0; i < slabCmdBuffers_.size(); i++) {
+			vk::CommandBuffer cmdBuffer = slabCmdBuffers_[i];
+			cmdBuffer.reset();
+			cmdBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+			memoryBarrier(cmdBuffer);
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current_], nullptr);
+			if (i == 0) {
+				recordStage(cmdBuffer, stage, dt, 0, 0, 2);
+				recordStage(cmdBuffer, stage, dt, 0, gridHeight_ - 2, gridHeight_);
+			}
+			else {
+				recordStage(cmdBuffer, stage, dt, 0, 2, gridHeight_ - 2);
+			}
+			memoryBarrier(cmdBuffer);
+			cmdBuffer.end();
+
+			vk::CommandBufferSubmitInfo commandBufferSubmitInfo{ cmdBuffer, 0 };
+
+			vk::SubmitInfo2 submitInfo{ vk::SubmitFlagBits(), nullptr, commandBufferSubmitInfo, nullptr };
+
+			queue_.submit2(submitInfo, slabFences_[i]);
+		}
+
+		vk::Result waitResult = device_.waitForFences(slabFences_[0], true, UINT64_MAX);
+		if (waitResult != vk::Result::eSuccess) throw std::runtime_error(vk::to_string(waitResult));
+
+		//	half step writes the half step buffer, full step writes the other wave function buffer
+		VmaAllocation stageAlloc = (stage == STAGE_HALF_STEP) ? psiAlloc_[2] : psiAlloc_[current_ ^ 1];
+		vmaCopyAllocationToMemory(allocator_, stageAlloc, rowSize, firstRow, rowSize);
+		vmaCopyAllocationToMemory(allocator_, stageAlloc, rowSize * (gridHeight_ - 2), lastRow, rowSize);
+
+		exchange(firstRow, lastRow, topHalo, bottomHalo);
+
+		//	rows on the global boundary are not halos
+		if (rowOffset_ > 0) {
+			vmaCopyMemoryToAllocation(allocator_, topHalo, stageAlloc, 0, rowSize);
+		}
+		if (rowOffset_ + gridHeight_ < globalHeight_) {
+			vmaCopyMemoryToAllocation(allocator_, bottomHalo, stageAlloc, rowSize * (gridHeight_ - 1), rowSize);
+		}
+
+		waitResult = device_.waitForFences(slabFences_[1], true, UINT64_MAX);
+		if (waitResult != vk::Result::eSuccess) throw std::runtime_error(vk::to_string(waitResult));
+		device_.resetFences(slabFences_);
+	}
+
+	current_ ^= 1;
+	time_ += dt;
+	stepCount_++;
+}
+
+
+
+std::vector<EigenResult> Schro2D::findEigenstates(const EigenSearch& search) {
+	checkCallerThread();
+	if (search.count == 0) return {};
+	if (gridHeight_ != globalHeight_) throw std::runtime_error("Eigenstate search is not supported on slabs");
+	reserveEigenstates(search.count);
+
+	device_.waitIdle();
+	time_ = 0;
+	stepCount_ = 0;
+	imaginaryTime_ = true;
+	eigenEnergies_.clear();
+
+	const uint32_t checkInterval = std::max(search.checkInterval, 1u);
+	std::vector<EigenResult> results{};
+	for (uint32_t k = 0; k < search.count; k++) {
+		//	random initial guess through descriptor set 0, leaving it in wave function buffer 1
+		uint32_t current = 1;
+		submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[0], nullptr);
+			recordStage(cmdBuffer, STAGE_INIT_NOISE, 0, k);
+		});
+
+		float energy = 0;
+		bool converged = false;
+		uint64_t steps = 0;
+		for (; steps < search.maxSteps && !converged; steps += checkInterval) {
+			//	step, orthogonalize against lower states, and renormalize, all on the gpu
+			submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+				cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+				for (uint32_t n = 0; n < checkInterval; n++) {
+					cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current], nullptr);
+					for (uint32_t stage : { STAGE_HALF_STEP, STAGE_FULL_STEP }) {
+						recordStage(cmdBuffer, stage, search.dt);
+						memoryBarrier(cmdBuffer);
+					}
+					for (uint32_t j = 0; j < k; j++) {
+						for (uint32_t stage : { STAGE_REDUCE_OVERLAP, STAGE_REDUCE_FINAL, STAGE_PROJECT }) {
+							recordStage(cmdBuffer, stage, search.dt, j);
+							memoryBarrier(cmdBuffer);
+						}
+					}
+					for (uint32_t stage : { STAGE_REDUCE, STAGE_REDUCE_FINAL, STAGE_NORMALIZE }) {
+						recordStage(cmdBuffer, stage, search.dt);
+						memoryBarrier(cmdBuffer);
+					}
+					current ^= 1;
+				}
+			});
+
+			//	energy of the state entering the last step
+			float totals[4];
+			vmaCopyAllocationToMemory(allocator_, reductionAlloc_, 0, totals, sizeof(totals));
+			float previous = energy;
+			energy = totals[1] / totals[2];
+			converged = steps > 0 && std::abs(energy - previous) <= search.tolerance * std::abs(energy);
+		}
+
+		//	descriptor set current ^ 1 writes wave function buffer current
+		submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current ^ 1], nullptr);
+			recordStage(cmdBuffer, STAGE_STORE_STATE, 0, k);
+		});
+		eigenEnergies_.emplace_back(energy);
+		results.push_back({ energy, steps, converged });
+	}
+
+	imaginaryTime_ = false;
+	eigenSearch_ = search;
+	eigenConverged_ = std::all_of(results.begin(), results.end(), [](const EigenResult& result) { return result.converged; });
+	return results;
+}
+
+
+
+void Schro2D::setEigenstate(uint32_t index) {
+	checkCallerThread();
+	if (index >= eigenEnergies_.size()) throw std::runtime_error("Eigenstate has not been found");
+
+	device_.waitIdle();
+	time_ = 0;
+
+	submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+		cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+		for (uint32_t i = 0; i < 2; i++) {
+			cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[i], nullptr);
+			recordStage(cmdBuffer, STAGE_LOAD_STATE, 0, index);
+		}
+	});
+	current_ = 0;
+	stepCount_ = 0;
+}
+
+
+
+void Schro2D::saveEigenstates(const std::string& path) {
+	checkCallerThread();
+	//	a cached state is reused without searching again, so only converged searches are kept
+	if (eigenEnergies_.empty() || !eigenConverged_) throw std::runtime_error("Only converged eigenstates can be cached");
+	device_.waitIdle();
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) throw std::runtime_error("Failed to write eigenstate cache");
+
+	EigenCacheHeader header{};
+	std::memcpy(header.magic, EIGEN_CACHE_MAGIC, sizeof(header.magic));
+	header.width = gridWidth_;
+	header.height = gridHeight_;
+	header.count = (uint32_t)eigenEnergies_.size();
+	header.version = EIGEN_CACHE_VERSION;
+	header.key = potentialKey();
+	header.searchKey = searchKey(eigenSearch_);
+
+	std::vector<std::complex<float>> states((size_t)gridWidth_ * gridHeight_ * header.count);
+	if (!states.empty()) {
+		vmaCopyAllocationToMemory(allocator_, eigenAlloc_, 0, states.data(), sizeof(std::complex<float>) * states.size());
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(eigenEnergies_.data()), sizeof(float) * eigenEnergies_.size());
+	file.write(reinterpret_cast<const char*>(states.data()), sizeof(std::complex<float>) * states.size());
+	if (!file) throw std::runtime_error("Failed to write eigenstate cache");
+}
+
+
+
+bool Schro2D::loadEigenstates(const std::string& path, const EigenSearch& search) {
+	checkCallerThread();
+	const uint32_t count = search.count;
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	EigenCacheHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (std::memcmp(header.magic, EIGEN_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+	if (header.version != EIGEN_CACHE_VERSION) return false;
+	if (header.width != gridWidth_ || header.height != gridHeight_ || header.key != potentialKey()) return false;
+	if (header.searchKey != searchKey(search)) return false;
+	if (count == 0 || header.count < count) return false;
+
+	//	states are stored lowest first, so a larger cache holds the requested ones at its start
+	std::vector<float> energies(header.count);
+	std::vector<std::complex<float>> states((size_t)gridWidth_ * gridHeight_ * count);
+	if (!file.read(reinterpret_cast<char*>(energies.data()), sizeof(float) * energies.size())) return false;
+	if (!file.read(reinterpret_cast<char*>(states.data()), sizeof(std::complex<float>) * states.size())) return false;
+	energies.resize(count);
+
+	reserveEigenstates(count);
+	device_.waitIdle();
+	vmaCopyMemoryToAllocation(allocator_, states.data(), eigenAlloc_, 0, sizeof(std::complex<float>) * states.size());
+	eigenEnergies_ = energies;
+	eigenSearch_ = search;
+	eigenConverged_ = true;
+	return true;
+}
+
+
+
+void Schro2D::run(float dt, uint64_t steps) {
+	checkCallerThread();
+	if (headless_) throw std::runtime_error("Headless solvers have no window to run");
 
 	//	render loop
 	uint8_t frameIdx = 0;
-	int frames = 0;
-	while (!glfwWindowShouldClose(window_)) {
+	uint64_t frames = 0;
+	while (!glfwWindowShouldClose(window_) && (steps == 0 || frames < steps)) {
 		glfwPollEvents();
-		draw(frameIdx, pushConst);
+		draw(frameIdx, dt);
 		frameIdx ^= 1;
+		current_ ^= 1;
+		time_ += dt;
+		stepCount_++;
+		frames++;
+
+		notifyObservers();
+	}
+	device_.waitIdle();
+}
+
 
-		if (frames % 100 == 0) {
-			std::vector<std::complex<float>> psiHost(wavefn.size() * wavefn[0].size());
-			vmaCopyAllocationToMemory(allocator_, psiAlloc_[0], 0, psiHost.data(), sizeof(std::complex<float>) * psiHost.size());
 
-			// Calculate normalization
-			float norm = 0;
-			for (const auto& val : psiHost) {
-				norm += std::norm(val) / (viewportWidth_ * viewportHeight_ * simScale_ * simScale_);
+
+//	---------------------------------------------------
+//	--	headless stepping:
+//	---------------------------------------------------
+#pragma region headless stepping;
+
+
+
+void Schro2D::setTimeStep(float dt) {
+	checkCallerThread();
+	dt_ = dt;
+}
+
+
+
+void Schro2D::step(uint64_t count) {
+	checkCallerThread();
+	if (gridHeight_ != globalHeight_) throw std::runtime_error("Stepping is not supported on slabs, use stepSlab");
+	device_.waitIdle();
+
+	while (count > 0) {
+		//	batches end where an observer is due, so its observables and snapshot match that step
+		uint64_t batch = std::min(count, MAX_STEP_BATCH);
+		{
+			std::lock_guard<std::mutex> lock(observerMutex_);
+			for (const auto& [id, entry] : observers_) {
+				batch = std::min(batch, entry.interval - stepCount_ % entry.interval);
+			}
+		}
+
+		submitImmediate([&](vk::CommandBuffer cmdBuffer) {
+			cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline_);
+			for (uint64_t n = 0; n < batch; n++) {
+				cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout_, 0, descriptorSets_[current_], nullptr);
+				for (uint32_t stage : { STAGE_HALF_STEP, STAGE_FULL_STEP }) {
+					recordStage(cmdBuffer, stage, dt_);
+					memoryBarrier(cmdBuffer);
+				}
+				current_ ^= 1;
+				time_ += dt_;
 			}
+		});
+		stepCount_ += batch;
+		count -= batch;
+
+		notifyObservers();
+	}
+}
+
+
+
+Observables Schro2D::observables() {
+	checkCallerThread();
+	if (gridHeight_ != globalHeight_) throw std::runtime_error("Observables are not supported on slabs, use observableSums");
+	auto [normSum, energySum] = observableSums();
+
+	Observables observables{};
+	observables.step = stepCount_;
+	observables.time = time_;
+	observables.norm = normSum / ((double)gridWidth_ * gridHeight_);
+	observables.energy = (normSum > 0) ? energySum / normSum : 0;
+	return observables;
+}
+
+
+
+StateView Schro2D::state() {
+	checkCallerThread();
+	device_.waitIdle();
+
+	stateHost_.resize((size_t)gridWidth_ * gridHeight_);
+	vmaCopyAllocationToMemory(allocator_, psiAlloc_[current_], 0, stateHost_.data(), sizeof(std::complex<float>) * stateHost_.size());
+	return { gridWidth_, gridHeight_, stateHost_.data() };
+}
+
+
+
+
+//	---------------------------------------------------
+//	--	observers:
+//	---------------------------------------------------
+#pragma region observers;
+
+
+
+uint32_t Schro2D::addObserver(Observer observer, uint32_t interval, bool snapshot) {
+	if (!observer) throw std::runtime_error("Observer is empty");
+	if (interval == 0) throw std::runtime_error("Observer interval must be positive");
+
+	std::lock_guard<std::mutex> lock(observerMutex_);
+	if (!observerThread_.joinable()) observerThread_ = std::thread(&Schro2D::observerLoop, this);
 
-			std::cout << frames << ",\t" << norm << "\n";
+	uint32_t id = nextObserverId_++;
+	observers_[id] = { std::move(observer), interval, snapshot };
+	return id;
+}
+
+
+
+void Schro2D::removeObserver(uint32_t id) {
+	std::lock_guard<std::mutex> lock(observerMutex_);
+	observers_.erase(id);
+}
+
+
+
+void Schro2D::flushObservers() {
+	checkCallerThread();
+	{
+		std::unique_lock<std::mutex> lock(observerMutex_);
+		observerCv_.wait(lock, [&] { return observerEvents_.empty() && !observerBusy_; });
+	}
+	rethrowObserverError();
+}
+
+
+
+void Schro2D::checkCallerThread() const {
+	if (std::this_thread::get_id() == observerThread_.get_id()) {
+		throw std::runtime_error("Only addObserver and removeObserver may be called from an observer callback");
+	}
+}
+
+
+
+void Schro2D::rethrowObserverError() {
+	std::exception_ptr error{};
+	{
+		std::lock_guard<std::mutex> lock(observerMutex_);
+		std::swap(error, observerError_);
+	}
+	if (error) std::rethrow_exception(error);
+}
+
+
+
+void Schro2D::notifyObservers() {
+	//	failures surface on the stepping thread at the next notification
+	rethrowObserverError();
+
+	ObserverEvent event{};
+	bool snapshot = false;
+	{
+		std::lock_guard<std::mutex> lock(observerMutex_);
+		for (const auto& [id, entry] : observers_) {
+			if (stepCount_ % entry.interval != 0) continue;
+			event.observerIds.emplace_back(id);
+			snapshot |= entry.snapshot;
 		}
+	}
+	if (event.observerIds.empty()) return;
+
+	//	one reduction and one copy per step, shared by every observer due
+	event.observables = observables();
+	if (snapshot) {
+		event.snapshot = std::make_shared<std::vector<std::complex<float>>>((size_t)gridWidth_ * gridHeight_);
+		vmaCopyAllocationToMemory(
+			allocator_, psiAlloc_[current_], 0, event.snapshot->data(), sizeof(std::complex<float>) * event.snapshot->size()
+		);
+	}
 
-		frames++;
+	//	stepping waits on slow observers rather than queueing snapshots without bound
+	std::unique_lock<std::mutex> lock(observerMutex_);
+	observerCv_.wait(lock, [&] { return observerEvents_.size() < MAX_QUEUED_EVENTS; });
+	observerEvents_.emplace_back(std::move(event));
+	observerCv_.notify_all();
+}
+
+
+
+void Schro2D::observerLoop() {
+	std::unique_lock<std::mutex> lock(observerMutex_);
+	while (true) {
+		observerCv_.wait(lock, [&] { return observerStopping_ || !observerEvents_.empty(); });
+		if (observerEvents_.empty()) return;
+
+		ObserverEvent event = std::move(observerEvents_.front());
+		observerEvents_.pop_front();
+		observerBusy_ = true;
+
+		//	observers removed since the event was queued are skipped
+		std::vector<std::pair<Observer, bool>> due{};
+		for (uint32_t id : event.observerIds) {
+			auto it = observers_.find(id);
+			if (it != observers_.end()) due.emplace_back(it->second.observer, it->second.snapshot);
+		}
+		observerCv_.notify_all();
+
+		//	callbacks run unlocked so they may add or remove observers
+		lock.unlock();
+		StateView view{ gridWidth_, gridHeight_, nullptr };
+		for (const auto& [observer, snapshot] : due) {
+			view.data = (snapshot && event.snapshot) ? event.snapshot->data() : nullptr;
+			try {
+				observer(event.observables, view);
+			}
+			catch (...) {
+				//	first failure is kept for the caller, later ones until it is rethrown are dropped
+				std::lock_guard<std::mutex> errorLock(observerMutex_);
+				if (!observerError_) observerError_ = std::current_exception();
+			}
+		}
+		lock.lock();
+
+		observerBusy_ = false;
+		observerCv_.notify_all();
 	}
 }
\ No newline at end of file
@@ -2,6 +2,16 @@
 
 //	std lib
 #include <complex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 //	glfw3
@@ -34,16 +44,176 @@ struct FrameData {
 
 
 
+//	potential primitive types
+enum class PotentialType : uint32_t {
+	Box = 0,				//	rectangle of constant potential
+	Slits = 1,				//	wall with evenly spaced openings along y
+	Harmonic = 2,			//	harmonic well, amplitude reached at extent
+	Gaussian = 3,			//	gaussian bump with extent as std deviation
+	PlaneWave = 4			//	plane wave driving field
+};
+
+
+
+//	parametric potential evaluated on the gpu each stage (std430 layout, mirrors shaders/schro.glsl)
+struct PotentialPrimitive {
+	float x = 0, y = 0;				//	center (cells)
+	float width = 0, height = 0;	//	extent (cells)
+	float vx = 0, vy = 0;			//	center velocity (cells/s)
+	float omega = 0;				//	amplitude angular frequency (rad/s)
+	float phase = 0;				//	amplitude phase (rad)
+	float amplitude = 0;			//	peak potential (eV)
+	float param0 = 0;				//	slits: opening width (cells), plane wave: kx (rad/cell)
+	float param1 = 0;				//	slits: opening separation (cells), plane wave: ky (rad/cell)
+	float reserved0 = 0;
+	PotentialType type = PotentialType::Box;
+	uint32_t count = 0;				//	slits: number of openings
+	uint32_t reserved1 = 0, reserved2 = 0;
+};
+static_assert(sizeof(PotentialPrimitive) == 64, "PotentialPrimitive must match std430 layout");
+
+
+
+//	gaussian wave packet generated on the gpu
+struct WavePacket {
+	float x = 0, y = 0;		//	center (cells)
+	float energy = 0;		//	kinetic energy (eV)
+	float angle = 0;		//	direction of travel (rad)
+	float sigma = 1;		//	envelope width (cells)
+};
+
+
+
+//	imaginary time eigenstate search parameters
+struct EigenSearch {
+	uint32_t count = 0;				//	number of states from the ground state up
+	float dt = 1e-15;				//	imaginary time stepsize (s)
+	float tolerance = 1e-6f;		//	relative energy change between checks counted as converged
+	uint32_t checkInterval = 100;	//	steps between energy checks
+	uint64_t maxSteps = 100000;		//	steps per state before giving up
+};
+
+
+
+//	outcome of the eigenstate search for one state
+struct EigenResult {
+	float energy = 0;				//	energy at the last check (eV)
+	uint64_t steps = 0;				//	imaginary time steps taken
+	bool converged = false;			//	false if maxSteps was reached first
+};
+
+
+
+//	horizontal band of a grid decomposed across devices, run headless
+struct Slab {
+	uint32_t width = 0;			//	grid width (cells)
+	uint32_t height = 0;		//	local rows, including the halo or boundary row above and below
+	uint32_t rowOffset = 0;		//	global row of local row 0
+	uint32_t globalHeight = 0;	//	global grid height (cells)
+	uint32_t deviceIndex = 0;	//	physical device index, wrapped to the number of devices
+
+	//	headless slab covering a whole grid
+	static Slab whole(uint32_t width, uint32_t height, uint32_t deviceIndex = 0) {
+		return { width, height, 0, height, deviceIndex };
+	}
+};
+
+
+
+//	publishes a slab's first and last owned rows and fills its halo rows from the neighbouring slabs
+using HaloExchange = std::function<void(const std::complex<float>* firstRow, const std::complex<float>* lastRow, 
+	std::complex<float>* topHalo, std::complex<float>* bottomHalo)>;
+
+
+
+//	scalar observables of the current wave function
+struct Observables {
+	uint64_t step = 0;				//	steps since the wave function was set
+	double time = 0;				//	simulation time (s)
+	double norm = 0;				//	mean |psi|^2, 1 when normalized
+	double energy = 0;				//	<psi|H|psi> / <psi|psi> (eV)
+};
+
+
+
+//	read only view of a wave function snapshot, row major
+struct StateView {
+	uint32_t width = 0;							//	grid width (cells)
+	uint32_t height = 0;						//	grid height (cells)
+	const std::complex<float>* data = nullptr;	//	width * height values, null if no snapshot was taken
+
+	const std::complex<float>& operator()(uint32_t x, uint32_t y) const { return data[x + (size_t)width * y]; }
+};
+
+
+
+//	callback invoked on the observer thread, the view is only valid during the call.
+//	callbacks may only call addObserver and removeObserver on their solver, other calls throw. 
+//	an exception thrown by a callback is rethrown by the next step, run or flushObservers
+using Observer = std::function<void(const Observables& observables, const StateView& state)>;
+
+
+
 //	schrodinger equation solver using vulkan
 class Schro2D {
 public:
 	//	initialize vulkan/glfw components
 	Schro2D(uint32_t width, uint32_t height, double scale);
+	//	initialize headless vulkan components for one slab of a decomposed grid, or Slab::whole for a full grid
+	explicit Schro2D(const Slab& slab);
 	//	cleanup vulkan/glfw components
 	~Schro2D();
-	//	runs schrodinger equation solver
-	void run(std::vector<std::vector<std::complex<float>>>& wavefn,
-		std::vector<std::vector<std::complex<float>>>& potential, float pushConst);
+	//	max number of potential primitives
+	static constexpr uint32_t MAX_PRIMITIVES = 64;
+
+	//	uploads parametric potentials evaluated on the gpu alongside the static potential
+	void setPotentials(const std::vector<PotentialPrimitive>& primitives);
+	//	uploads a static potential grid (row major, gridWidth x gridHeight), zero by default
+	void setStaticPotential(const std::vector<std::complex<float>>& potential);
+	//	generates and normalizes the initial wave packet on the gpu, resetting simulation time, throws if it has no norm
+	//	slabs are left unnormalized, normalize them with the sum of normSum() over all slabs
+	void setWavePacket(const WavePacket& packet);
+	//	sum of |psi|^2 over owned cells of the current wave function
+	double normSum();
+	//	sums of |psi|^2 and Re<psi|H|psi> over owned cells of the current wave function, added across slabs for observables
+	std::pair<double, double> observableSums();
+	//	scales the wave function to unit mean density given the global sum of |psi|^2, throws if the sum is not positive
+	void normalize(double globalNormSum);
+	//	advances a slab one step, exchanging halos after each stage while interior rows are computed
+	void stepSlab(float dt, const HaloExchange& exchange);
+	//	finds the lowest eigenstates of the current potentials by imaginary time propagation, returning one result per state
+	//	overwrites the wave function, call setWavePacket or setEigenstate afterwards
+	std::vector<EigenResult> findEigenstates(const EigenSearch& search);
+	//	loads a found eigenstate as the wave function, resetting simulation time
+	void setEigenstate(uint32_t index);
+	//	writes found eigenstates and energies to a cache file, throws unless every state converged
+	void saveEigenstates(const std::string& path);
+	//	reads the lowest search.count eigenstates from a cache file, returns false if missing, 
+	//	made for another grid, potential or search settings, or holding fewer states
+	bool loadEigenstates(const std::string& path, const EigenSearch& search);
+	//	runs schrodinger equation solver in the window for steps (0 until window closes), notifying observers
+	void run(float dt, uint64_t steps = 0);
+
+	//	---------------------------------------------------
+	//	--	headless stepping:
+	//	---------------------------------------------------
+
+	//	sets time stepsize used by step
+	void setTimeStep(float dt);
+	//	advances a headless full grid count steps in batched submissions, notifying observers
+	void step(uint64_t count = 1);
+	//	computes observables of the current wave function on the gpu
+	Observables observables();
+	//	copies the current wave function to the host, the view is valid until the next call
+	StateView state();
+
+	//	registers an observer called every interval steps on a background thread, returns id for removeObserver
+	//	snapshot copies the wave function for the observer, otherwise the view data is null
+	uint32_t addObserver(Observer observer, uint32_t interval, bool snapshot = true);
+	//	unregisters an observer, callbacks already queued for it are skipped
+	void removeObserver(uint32_t id);
+	//	blocks until queued observer callbacks have run, rethrowing the first exception a callback threw
+	void flushObservers();
 
 private:
 	//	---------------------------------------------------
@@ -64,15 +234,41 @@ private:
 	void createAllocator();
 	//	initializes swapchain with images and sync structures
 	void createSwapChain();
+	//	initializes offscreen storage image bound in place of the swapchain when headless
+	void createOffscreenImage();
+	//	initializes command pool, command buffer, and fence for blocking submissions
+	void createImmediateCommands();
 	//	initializes compute pipeline, storage buffers, and descriptor sets
 	void createComputePipeline();
 
+	//	---------------------------------------------------
+	//	--	command recording:
+	//	---------------------------------------------------
+
+	//	records commands and blocks until the gpu has executed them
+	void submitImmediate(const std::function<void(vk::CommandBuffer)>& record);
+	//	records one solver stage over the simulation grid with the bound descriptor set
+	void recordStage(vk::CommandBuffer cmdBuffer, uint32_t stage, float dt, uint32_t stateIdx = 0,
+		uint32_t rowBegin = 0, uint32_t rowEnd = UINT32_MAX);
+	//	grows eigenstate storage to hold count states, rebinding descriptor sets
+	void reserveEigenstates(uint32_t count);
+	//	hash of grid size and potentials identifying cached eigenstates
+	uint64_t potentialKey() const;
+
 	//	---------------------------------------------------
 	//	--	simulation loop:
 	//	---------------------------------------------------
 
 	//	step schrodinger solver and update window
 	void draw(uint8_t frameIdx, float pushConst);
+	//	queues observables and snapshots for observers due at the current step
+	void notifyObservers();
+	//	observer thread body, runs queued callbacks until stopped
+	void observerLoop();
+	//	throws if called from an observer callback, which would wait on itself or race the stepping thread
+	void checkCallerThread() const;
+	//	rethrows and clears the first exception thrown by a callback
+	void rethrowObserverError();
 
 	//	---------------------------------------------------
 	//	--	context configuration vars and components:
@@ -82,6 +278,12 @@ private:
 	const uint32_t viewportWidth_;						//	glfw window width (pixels)
 	const uint32_t viewportHeight_;						//	glfw window height (pixels)
 	const double simScale_;								//	multiplier for sim resolution
+	const uint32_t gridWidth_;							//	simulation grid width (cells)
+	const uint32_t gridHeight_;							//	simulation grid height, local rows for slabs (cells)
+	const uint32_t rowOffset_;							//	global row of local row 0
+	const uint32_t globalHeight_;						//	global grid height (cells)
+	const uint32_t deviceIndex_;						//	physical device index
+	const bool headless_;								//	toggle for running without window or swapchain
 	
 	//	engine components
 	vk::Instance instance_{};							//	instance
@@ -97,17 +299,73 @@ private:
 	vk::SwapchainKHR swapchain_{};						//	swapchain
 	std::vector<FrameData> frameData_{};				//	per frame data structures
 
+	//	headless render components
+	vk::Image offscreenImage_{};						//	offscreen image
+	VmaAllocation offscreenAlloc_{};					//	memory allocation for offscreen image
+	vk::ImageView offscreenView_{};						//	offscreen image view
+
+	//	blocking submission components
+	vk::CommandPool immCmdPool_{};						//	command pool
+	vk::CommandBuffer immCmdBuffer_{};					//	command buffer
+	vk::Fence immFence_{};								//	fence
+	std::vector<vk::CommandBuffer> slabCmdBuffers_{};	//	edge and interior command buffers for slab steps
+	std::vector<vk::Fence> slabFences_{};				//	edge and interior fences for slab steps
+	std::vector<std::complex<float>> haloRows_{};		//	host staging for first, last, top halo, bottom halo rows
+
 	//	compute pipeline
 	vk::ShaderModule shaderModule_{};					//	schrodinger solver shader module
 	vk::DescriptorSetLayout descriptorSetLayout_{};		//	descriptor set layout
 	vk::PipelineLayout pipelineLayout_{};				//	pipeline layout
 	vk::Pipeline computePipeline_{};					//	compute pipeline
 	vk::DescriptorPool descriptorPool_{};				//	descriptor pool
-	std::vector<vk::DescriptorSet> descriptorSets_{};	//	descriptor sets
+	std::vector<vk::DescriptorSet> descriptorSets_{};	//	descriptor sets, 2 * image + wave function buffer read
 
 	//	compute storage
 	std::vector<vk::Buffer> psiBuffer_{};				//	buffers containing wave function values
 	std::vector<VmaAllocation> psiAlloc_{};				//	memory allocation for wave function buffer
 	vk::Buffer vBuffer_{};								//	buffer containing potential values
 	VmaAllocation vAlloc_{};							//	memory allocation for potential buffer
+	vk::Buffer primitiveBuffer_{};						//	buffer containing potential primitives
+	VmaAllocation primitiveAlloc_{};					//	memory allocation for potential primitive buffer
+	std::vector<PotentialPrimitive> primitives_{};		//	active potential primitives
+	vk::Buffer reductionBuffer_{};						//	buffer containing reduction partial sums
+	VmaAllocation reductionAlloc_{};					//	memory allocation for reduction buffer
+	WavePacket packet_{};								//	initial wave packet parameters
+	uint64_t staticPotentialHash_ = 0;					//	hash of static potential grid, 0 if unset
+
+	//	eigenstate storage
+	vk::Buffer eigenBuffer_{};							//	buffer containing eigenstates
+	VmaAllocation eigenAlloc_{};						//	memory allocation for eigenstate buffer
+	uint32_t eigenCapacity_ = 0;						//	number of states eigenstate buffer can hold
+	std::vector<float> eigenEnergies_{};				//	energies of found eigenstates (eV)
+	EigenSearch eigenSearch_{};							//	settings of the search that found the eigenstates
+	bool eigenConverged_ = false;						//	toggle for every found eigenstate having converged
+	bool imaginaryTime_ = false;						//	toggle for imaginary time propagation
+	double time_ = 0;									//	simulation time (s), double so small steps are not lost over long runs
+	uint32_t current_ = 0;								//	wave function buffer holding current state
+	uint64_t stepCount_ = 0;							//	steps since the wave function was set
+	float dt_ = 1e-15f;									//	time stepsize used by step (s)
+	std::vector<std::complex<float>> stateHost_{};		//	host copy backing state()
+
+	//	observers
+	struct ObserverEntry {
+		Observer observer;								//	callback
+		uint32_t interval;								//	steps between calls
+		bool snapshot;									//	toggle for copying the wave function
+	};
+	struct ObserverEvent {
+		Observables observables;						//	observables at the step
+		std::shared_ptr<std::vector<std::complex<float>>> snapshot;	//	wave function, null if not requested
+		std::vector<uint32_t> observerIds;				//	observers due at the step
+	};
+	static constexpr size_t MAX_QUEUED_EVENTS = 4;		//	events queued before stepping waits on observers
+	std::mutex observerMutex_{};						//	guards observer state below
+	std::condition_variable observerCv_{};				//	signals queue changes
+	std::map<uint32_t, ObserverEntry> observers_{};		//	registered observers by id
+	uint32_t nextObserverId_ = 0;						//	id given to the next observer
+	std::deque<ObserverEvent> observerEvents_{};		//	queued events
+	bool observerBusy_ = false;							//	toggle for observer thread running callbacks
+	bool observerStopping_ = false;						//	toggle for observer thread shutdown
+	std::exception_ptr observerError_{};				//	first exception thrown by a callback, rethrown on the caller's thread
+	std::thread observerThread_{};						//	observer thread, started with the first observer
 };
\ No newline at end of file